@@ -0,0 +1,282 @@
+/*
+This file defines a binary file format for galaxy catalogs: write_catalog_file() writes a
+GalaxyCatalog, and optionally the parents of a GalaxyHierarchy, and the CatalogFile class maps
+such a file and reads its columns in place. Requires C++20 (std::span). POSIX only (mmap).
+
+Layout, version 1, in the byte order of the writing machine:
+- a 96 byte header: magic "GALAXCAT", version, byte order mark, number of galaxies, bytes of
+  names, flags and the offset of every section;
+- the sections, each starting on a multiple of 64 bytes: redshift, mass_tot and stellar_frac
+  (double), Hubble type (one byte code), name offsets (uint64, galaxies + 1 values), names
+  (characters back to back) and, with the has_parents flag, parents (uint32, no_galaxy for none).
+*/
+
+#ifndef CATALOG_FILE_HPP
+#define CATALOG_FILE_HPP
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include "MappedFile.hpp"
+#include "GalaxyCatalog.hpp"
+#include "GalaxyHierarchy.hpp"
+
+const char catalog_file_magic[8] = {'G', 'A', 'L', 'A', 'X', 'C', 'A', 'T'};
+const std::uint32_t catalog_file_version = 1;
+// Written as a number, read back as 0x04030201 on a machine of the other byte order.
+const std::uint32_t catalog_file_byte_order = 0x01020304;
+const std::uint64_t catalog_file_has_parents = 1;
+const std::uint64_t catalog_file_alignment = 64;
+
+enum class CatalogSection {redshift, mass_tot, stellar_frac, hubble_type, name_offsets, names, parents};
+const std::size_t catalog_section_count = 7;
+
+struct CatalogFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t rows;
+    std::uint64_t name_bytes;
+    std::uint64_t flags;
+    std::uint64_t section_offsets[catalog_section_count];
+};
+static_assert(sizeof(CatalogFileHeader) == 96 && std::is_trivially_copyable_v<CatalogFileHeader>);
+
+// Bytes of a section for a catalog of the given size.
+std::uint64_t catalog_section_size(CatalogSection section, std::uint64_t rows, std::uint64_t name_bytes,
+                                   bool has_parents)
+{
+    switch (section) {
+        case CatalogSection::redshift:
+        case CatalogSection::mass_tot:
+        case CatalogSection::stellar_frac: return rows * sizeof(double);
+        case CatalogSection::hubble_type: return rows * sizeof(HubbleType);
+        case CatalogSection::name_offsets: return (rows + 1) * sizeof(std::uint64_t);
+        case CatalogSection::names: return name_bytes;
+        case CatalogSection::parents: return has_parents ? rows * sizeof(RowId) : 0;
+    }
+    return 0;
+}
+
+/*
+Write catalog, and the parent of every galaxy in hierarchy when it is not null, to filename.
+The columns go from the catalog to the stream as they are, without a copy of the file in memory.
+Throws std::invalid_argument if the hierarchy is not over as many galaxies as the catalog,
+std::runtime_error if the file cannot be written.
+*/
+void write_catalog_file(const std::string& filename, const GalaxyCatalog& catalog,
+                        const GalaxyHierarchy* hierarchy = nullptr)
+{
+    if (hierarchy && hierarchy->get_parents().size() != catalog.size()) {
+        throw std::invalid_argument("The hierarchy does not match the catalog");
+    }
+
+    CatalogFileHeader header{};
+    std::memcpy(header.magic, catalog_file_magic, sizeof(header.magic));
+    header.version = catalog_file_version;
+    header.byte_order = catalog_file_byte_order;
+    header.rows = catalog.size();
+    header.name_bytes = catalog.get_names().size();
+    header.flags = hierarchy ? catalog_file_has_parents : 0;
+
+    const std::string_view names = catalog.get_names();
+    const void* sections[catalog_section_count] = {
+        catalog.get_redshift().data(), catalog.get_mass_tot().data(), catalog.get_stellar_frac().data(),
+        catalog.get_hubble_types().data(), catalog.get_name_offsets().data(), names.data(),
+        hierarchy ? hierarchy->get_parents().data() : nullptr};
+
+    std::uint64_t offset = sizeof(header);
+    for (std::size_t s = 0; s < catalog_section_count; ++s) {
+        offset = (offset + catalog_file_alignment - 1) / catalog_file_alignment * catalog_file_alignment;
+        header.section_offsets[s] = offset;
+        offset += catalog_section_size(static_cast<CatalogSection>(s), header.rows, header.name_bytes,
+                                       hierarchy != nullptr);
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("Could not open " + filename);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[catalog_file_alignment] = {};
+    std::uint64_t written = sizeof(header);
+    for (std::size_t s = 0; s < catalog_section_count; ++s) {
+        file.write(padding, header.section_offsets[s] - written);
+        std::uint64_t size = catalog_section_size(static_cast<CatalogSection>(s), header.rows, header.name_bytes,
+                                                  hierarchy != nullptr);
+        if (size > 0) file.write(static_cast<const char*>(sections[s]), size);
+        written = header.section_offsets[s] + size;
+    }
+    file.close();
+    if (!file) throw std::runtime_error("Could not write " + filename);
+}
+
+/*
+Class name: CatalogFile
+--------------------
+Description: A catalog file mapped into memory. The columns are spans over the mapping, so
+opening a file only reads and checks its header, whatever the number of galaxies, and pages
+are read from disk when a column is first used. The spans are valid as long as the CatalogFile.
+Opening checks that the sections fit in the file, not the values in them: validate() checks
+every value, once, before a file from an untrusted source is used.
+----------------------------------------
+Attributes:
+- file: (MappedFile) the mapping.
+- header: (CatalogFileHeader) a copy of the header.
+----------------------------------------
+Methods:
+- CatalogFile(const std::string& filename)
+    Map and check the file. Throws std::runtime_error if it cannot be read, is not a catalog
+    file, has another version or byte order, or is truncated.
+- size(), has_parents()
+    Number of galaxies, and whether the file has a parent column.
+- get_redshift(), get_mass_tot(), get_stellar_frac(), get_hubble_types(), get_name_offsets(), get_names()
+    The columns, like those of GalaxyCatalog.
+- get_parents()
+    The parent of every galaxy, empty without a parent column.
+- name(i)
+    Name of galaxy i.
+- validate()
+    Check every value: the galaxy attributes with the rules of Galaxy, the name offsets and
+    the parents. Throws std::runtime_error naming the first invalid row.
+- to_catalog()
+    Validate, then copy the galaxies into a GalaxyCatalog.
+*/
+class CatalogFile
+{
+private:
+    MappedFile file;
+    CatalogFileHeader header;
+
+    const char* section(CatalogSection s) const {return file.data() + header.section_offsets[static_cast<std::size_t>(s)];}
+    template <typename T>
+    std::span<const T> column(CatalogSection s, std::size_t count) const
+    {
+        return std::span<const T>(reinterpret_cast<const T*>(section(s)), count);
+    }
+
+public:
+    CatalogFile(const std::string& filename);
+
+    std::size_t size() const {return header.rows;}
+    bool has_parents() const {return (header.flags & catalog_file_has_parents) != 0;}
+
+    std::span<const double> get_redshift() const {return column<double>(CatalogSection::redshift, size());}
+    std::span<const double> get_mass_tot() const {return column<double>(CatalogSection::mass_tot, size());}
+    std::span<const double> get_stellar_frac() const {return column<double>(CatalogSection::stellar_frac, size());}
+    std::span<const HubbleType> get_hubble_types() const
+    {
+        return column<HubbleType>(CatalogSection::hubble_type, size());
+    }
+    std::span<const std::uint64_t> get_name_offsets() const
+    {
+        return column<std::uint64_t>(CatalogSection::name_offsets, size() + 1);
+    }
+    std::string_view get_names() const {return std::string_view(section(CatalogSection::names), header.name_bytes);}
+    std::span<const RowId> get_parents() const
+    {
+        return column<RowId>(CatalogSection::parents, has_parents() ? size() : 0);
+    }
+
+    std::string_view name(std::size_t i) const;
+    void validate() const;
+    GalaxyCatalog to_catalog() const;
+};
+
+CatalogFile::CatalogFile(const std::string& filename) : file(filename)
+{
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error(filename + " is not a galaxy catalog file");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, catalog_file_magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(filename + " is not a galaxy catalog file");
+    }
+    // Byte order first: the version of a swapped file reads as a wrong version too.
+    if (header.byte_order != catalog_file_byte_order) {
+        throw std::runtime_error(filename + " was written on a machine of another byte order");
+    }
+    if (header.version != catalog_file_version) {
+        throw std::runtime_error(filename + " has version " + std::to_string(header.version) +
+                                 ", only version " + std::to_string(catalog_file_version) + " can be read");
+    }
+
+    // Checked against the file size first, so the section sizes below cannot overflow.
+    if (header.rows > file.size() || header.name_bytes > file.size() ||
+        (has_parents() && header.rows > no_galaxy)) {
+        throw std::runtime_error(filename + " is truncated or corrupted");
+    }
+    for (std::size_t s = 0; s < catalog_section_count; ++s) {
+        std::uint64_t offset = header.section_offsets[s];
+        std::uint64_t size = catalog_section_size(static_cast<CatalogSection>(s), header.rows, header.name_bytes,
+                                                  has_parents());
+        if (offset % catalog_file_alignment != 0 || offset > file.size() || size > file.size() - offset) {
+            throw std::runtime_error(filename + " is truncated or corrupted");
+        }
+    }
+}
+
+std::string_view CatalogFile::name(std::size_t i) const
+{
+    std::span<const std::uint64_t> offsets = get_name_offsets();
+    return get_names().substr(offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+/*
+Like GalaxyCatalog::append_columns(), the checks are ORed together in branch-free loops; only
+if one failed does a slow pass look at the rows one by one to name the first invalid one.
+*/
+void CatalogFile::validate() const
+{
+    const std::size_t n = size();
+    std::span<const double> redshift = get_redshift(), mass = get_mass_tot(), fraction = get_stellar_frac();
+    std::span<const std::uint8_t> types(reinterpret_cast<const std::uint8_t*>(get_hubble_types().data()), n);
+    std::span<const std::uint64_t> offsets = get_name_offsets();
+    std::span<const RowId> parents = get_parents();
+
+    bool any_invalid = offsets[0] != 0 || offsets[n] != header.name_bytes;
+    for (std::size_t i = 0; i < n; ++i) {
+        any_invalid |= !is_valid_redshift(redshift[i]) | !is_valid_mass_tot(mass[i]) |
+                       !is_valid_stellar_frac(fraction[i]) | (types[i] >= hubble_type_count) |
+                       (offsets[i] > offsets[i + 1]);
+    }
+    for (std::size_t i = 0; i < parents.size(); ++i) {
+        any_invalid |= (parents[i] >= n) & (parents[i] != no_galaxy);
+    }
+    if (!any_invalid) return;
+
+    if (offsets[0] != 0 || offsets[n] != header.name_bytes) {
+        throw std::runtime_error("Invalid name offsets in the catalog file");
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!is_valid_redshift(redshift[i]) || !is_valid_mass_tot(mass[i]) || !is_valid_stellar_frac(fraction[i]) ||
+            types[i] >= hubble_type_count || offsets[i] > offsets[i + 1] ||
+            (!parents.empty() && parents[i] >= n && parents[i] != no_galaxy)) {
+            throw std::runtime_error("Invalid galaxy in row " + std::to_string(i) + " of the catalog file");
+        }
+    }
+}
+
+GalaxyCatalog CatalogFile::to_catalog() const
+{
+    validate();
+    GalaxyCatalog catalog;
+    std::string_view names = get_names();
+    std::span<const std::uint64_t> offsets = get_name_offsets();
+    std::span<const HubbleType> types = get_hubble_types();
+    std::span<const double> redshift = get_redshift(), mass = get_mass_tot(), fraction = get_stellar_frac();
+    catalog.names.assign(names.begin(), names.end());
+    catalog.name_offsets.assign(offsets.begin(), offsets.end());
+    catalog.hubble_types.assign(types.begin(), types.end());
+    catalog.redshift.assign(redshift.begin(), redshift.end());
+    catalog.mass_tot.assign(mass.begin(), mass.end());
+    catalog.stellar_frac.assign(fraction.begin(), fraction.end());
+    return catalog;
+}
+
+#endif
@@ -0,0 +1,348 @@
+/*
+This file defines histograms over the columns of a GalaxyCatalog: linear or logarithmic
+binning, two-dimensional histograms such as redshift x stellar mass, and weighted counts.
+The results do not depend on the number of threads. Requires C++20 (std::span).
+*/
+
+#ifndef CATALOG_HISTOGRAM_HPP
+#define CATALOG_HISTOGRAM_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <span>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "Parallel.hpp"
+#include "Table.hpp"
+#include "GalaxyCatalog.hpp"
+
+enum class AxisScale {linear, log10};
+
+// Rows binned by one task. The partial sums of each chunk are merged in chunk order, so the
+// chunks, and the rounding of the weights, are the same whatever the number of threads.
+const std::size_t histogram_chunk_rows = 1 << 16;
+
+// Rows whose bin indices are computed together, in buffers on the stack.
+const std::size_t histogram_block_rows = 256;
+
+// Largest number of bins on an axis, so that bin indices fit in 32-bit integers.
+const std::size_t max_histogram_bins = 1 << 20;
+
+/*
+Bins of equal width between min and max, in the values themselves or in their decimal
+logarithm: AxisScale::log10 with min 1e6, max 1e12 and 12 bins has bins of half a dex.
+A bin contains its lower edge; max itself is outside the axis.
+Throws std::invalid_argument for no bins, too many bins, min >= max, a non-finite edge or a
+log10 axis that does not start above 0.
+*/
+struct HistogramAxis
+{
+    double min;
+    double max;
+    std::size_t bins;
+    AxisScale scale;
+
+    HistogramAxis(double min_in, double max_in, std::size_t bins_in, AxisScale scale_in = AxisScale::linear);
+    double edge(std::size_t i) const;       // Lower edge of bin i, upper edge of bin i - 1.
+};
+
+HistogramAxis::HistogramAxis(double min_in, double max_in, std::size_t bins_in, AxisScale scale_in) :
+    min(min_in), max(max_in), bins(bins_in), scale(scale_in)
+{
+    if (bins == 0 || bins > max_histogram_bins) {
+        throw std::invalid_argument("A histogram axis needs between 1 and " + std::to_string(max_histogram_bins) + " bins");
+    }
+    if (!std::isfinite(min) || !std::isfinite(max) || min >= max) {
+        throw std::invalid_argument("A histogram axis needs finite edges with min < max");
+    }
+    if (scale == AxisScale::log10 && min <= 0) {
+        throw std::invalid_argument("A logarithmic histogram axis must start above 0");
+    }
+}
+
+double HistogramAxis::edge(std::size_t i) const
+{
+    if (scale == AxisScale::linear) return min + (max - min) * i / bins;
+    double low = std::log10(min), high = std::log10(max);
+    return std::pow(10.0, low + (high - low) * i / bins);
+}
+
+/*
+Class name: Histogram
+--------------------
+Description: Counts and sums of weights in the bins of one axis, or in the cells of two axes.
+A one-dimensional histogram has a y axis of a single bin that every value falls in.
+Cells are stored x bin first: the cell (ix, iy) is at ix + iy * x bins.
+Values outside an axis, and NaN, are not in any cell but in the outside totals.
+----------------------------------------
+Attributes:
+- x_axis, y_axis: (HistogramAxis) the axes.
+- counts: (vector of uint64) number of values in each cell.
+- weights: (vector of double) sum of the weights in each cell, the counts without weights.
+- outside_count, outside_weight: values outside the axes.
+----------------------------------------
+Methods:
+- Histogram(HistogramAxis x_axis_in, HistogramAxis y_axis_in)
+    Empty histogram.
+- get_x_axis(), get_y_axis(), get_counts(), get_weights(), get_outside_count(), get_outside_weight()
+    Getters.
+- count(std::size_t ix, std::size_t iy), weight(std::size_t ix, std::size_t iy)
+    One cell. Throws std::out_of_range for a cell that does not exist.
+- total_count(), total_weight()
+    Sums over the cells, without the outside totals.
+- display_histogram(std::ostream& os)
+    Print one row per cell with its edges, its count and its weight.
+*/
+class Histogram
+{
+private:
+    HistogramAxis x_axis;
+    HistogramAxis y_axis;
+    std::vector<std::uint64_t> counts;
+    std::vector<double> weights;
+    std::uint64_t outside_count = 0;
+    double outside_weight = 0;
+
+    template <typename Load>
+    friend Histogram fill_histogram_blocks(std::size_t, const HistogramAxis&, const HistogramAxis*,
+                                           std::span<const double>, unsigned, Load&&);
+
+public:
+    Histogram(HistogramAxis x_axis_in, HistogramAxis y_axis_in = HistogramAxis(0, 1, 1));
+
+    const HistogramAxis& get_x_axis() const {return x_axis;}
+    const HistogramAxis& get_y_axis() const {return y_axis;}
+    std::span<const std::uint64_t> get_counts() const {return counts;}
+    std::span<const double> get_weights() const {return weights;}
+    std::uint64_t get_outside_count() const {return outside_count;}
+    double get_outside_weight() const {return outside_weight;}
+
+    std::uint64_t count(std::size_t ix, std::size_t iy = 0) const;
+    double weight(std::size_t ix, std::size_t iy = 0) const;
+    std::uint64_t total_count() const;
+    double total_weight() const;
+    void display_histogram(std::ostream& os = std::cout) const;
+};
+
+Histogram::Histogram(HistogramAxis x_axis_in, HistogramAxis y_axis_in) :
+    x_axis(x_axis_in), y_axis(y_axis_in),
+    counts(x_axis.bins * y_axis.bins, 0), weights(x_axis.bins * y_axis.bins, 0)
+{
+}
+
+std::uint64_t Histogram::count(std::size_t ix, std::size_t iy) const
+{
+    if (ix >= x_axis.bins || iy >= y_axis.bins) throw std::out_of_range("Histogram cell out of range");
+    return counts[ix + iy * x_axis.bins];
+}
+
+double Histogram::weight(std::size_t ix, std::size_t iy) const
+{
+    if (ix >= x_axis.bins || iy >= y_axis.bins) throw std::out_of_range("Histogram cell out of range");
+    return weights[ix + iy * x_axis.bins];
+}
+
+std::uint64_t Histogram::total_count() const
+{
+    std::uint64_t total = 0;
+    for (auto it = counts.begin(); it != counts.end(); ++it) {
+        total += *it;
+    }
+    return total;
+}
+
+double Histogram::total_weight() const
+{
+    double total = 0;
+    for (auto it = weights.begin(); it != weights.end(); ++it) {
+        total += *it;
+    }
+    return total;
+}
+
+void Histogram::display_histogram(std::ostream& os) const
+{
+    bool two_dimensional = y_axis.bins > 1;
+    std::vector<std::string> headers{"x from", "x to"};
+    if (two_dimensional) {
+        headers.push_back("y from");
+        headers.push_back("y to");
+    }
+    headers.push_back("Count");
+    headers.push_back("Weight");
+
+    Table table(headers);
+    table.reserve_rows(counts.size());
+    for (std::size_t iy = 0; iy < y_axis.bins; ++iy) {
+        for (std::size_t ix = 0; ix < x_axis.bins; ++ix) {
+            std::size_t cell = ix + iy * x_axis.bins;
+            std::vector<std::string> row{to_string_format(x_axis.edge(ix)), to_string_format(x_axis.edge(ix + 1))};
+            if (two_dimensional) {
+                row.push_back(to_string_format(y_axis.edge(iy)));
+                row.push_back(to_string_format(y_axis.edge(iy + 1)));
+            }
+            row.push_back(to_string_format(counts[cell]));
+            row.push_back(to_string_format(weights[cell]));
+            table.append_row(row);
+        }
+    }
+    table.display_table(os);
+}
+
+/*
+Replace the values by their logarithm for a log10 axis, then write the bin of every value to
+bins_out, and axis.bins for a value outside the axis. The comparisons are turned into selects
+rather than branches, so the compiler vectorizes the loop; NaN fails both comparisons.
+*/
+void compute_bin_indices(const HistogramAxis& axis, double* values, std::size_t count, std::int32_t* bins_out)
+{
+    double low = axis.min, high = axis.max;
+    if (axis.scale == AxisScale::log10) {
+        for (std::size_t k = 0; k < count; ++k) {
+            values[k] = std::log10(values[k]);
+        }
+        low = std::log10(low);
+        high = std::log10(high);
+    }
+    const double scale = axis.bins / (high - low);
+    const double outside = static_cast<double>(axis.bins);
+    for (std::size_t k = 0; k < count; ++k) {
+        double t = (values[k] - low) * scale;
+        bool inside = (t >= 0.0) & (t < outside);
+        bins_out[k] = static_cast<std::int32_t>(inside ? t : outside);
+    }
+}
+
+/*
+Bin n rows. load(begin, count, x, y) writes the x values, and the y values when y_axis is not
+null, of rows [begin, begin + count) to the buffers x and y. weights is empty or has n values.
+Every chunk of rows gets its own partial histogram, with one extra bin per axis for the values
+outside it; the chunks are shared out between the threads, and every cell sums its partials
+in chunk order. Chunks are made longer for histograms with many cells, so that the partials
+never take more memory than about the rows themselves.
+*/
+template <typename Load>
+Histogram fill_histogram_blocks(std::size_t n, const HistogramAxis& x_axis, const HistogramAxis* y_axis,
+                                std::span<const double> weights, unsigned threads, Load&& load)
+{
+    if (!weights.empty() && weights.size() != n) {
+        throw std::invalid_argument("A histogram needs one weight per value");
+    }
+    Histogram histogram = y_axis ? Histogram(x_axis, *y_axis) : Histogram(x_axis);
+    const std::size_t stride = x_axis.bins + 1;
+    const std::size_t cells = stride * (histogram.y_axis.bins + 1);
+    const std::size_t chunk_rows = std::max(histogram_chunk_rows, 8 * cells);
+    const std::size_t chunks = (n + chunk_rows - 1) / chunk_rows;
+    const bool weighted = !weights.empty();
+
+    std::vector<std::uint64_t> partial_counts(chunks * cells, 0);
+    std::vector<double> partial_weights(weighted ? chunks * cells : 0, 0.0);
+
+    parallel_for(chunks, threads, [&](std::size_t first, std::size_t last) {
+        double x[histogram_block_rows], y[histogram_block_rows];
+        std::int32_t ix[histogram_block_rows], iy[histogram_block_rows];
+        for (std::size_t chunk = first; chunk < last; ++chunk) {
+            std::uint64_t* chunk_counts = partial_counts.data() + chunk * cells;
+            double* chunk_weights = weighted ? partial_weights.data() + chunk * cells : nullptr;
+            std::size_t chunk_end = std::min(n, (chunk + 1) * chunk_rows);
+            for (std::size_t begin = chunk * chunk_rows; begin < chunk_end; begin += histogram_block_rows) {
+                std::size_t count = std::min(histogram_block_rows, chunk_end - begin);
+                load(begin, count, x, y);
+                compute_bin_indices(x_axis, x, count, ix);
+                if (y_axis) {
+                    compute_bin_indices(*y_axis, y, count, iy);
+                } else {
+                    std::fill(iy, iy + count, 0);
+                }
+                for (std::size_t k = 0; k < count; ++k) {
+                    ++chunk_counts[ix[k] + iy[k] * stride];
+                }
+                if (weighted) {
+                    for (std::size_t k = 0; k < count; ++k) {
+                        chunk_weights[ix[k] + iy[k] * stride] += weights[begin + k];
+                    }
+                }
+            }
+        }
+    });
+
+    // Merge, the cells shared out between the threads and the chunks of a cell in order.
+    std::vector<std::uint64_t> cell_counts(cells, 0);
+    std::vector<double> cell_weights(cells, 0.0);
+    parallel_for(cells, threads, [&](std::size_t first, std::size_t last) {
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            for (std::size_t cell = first; cell < last; ++cell) {
+                cell_counts[cell] += partial_counts[chunk * cells + cell];
+                if (weighted) cell_weights[cell] += partial_weights[chunk * cells + cell];
+            }
+        }
+    });
+
+    for (std::size_t cell = 0; cell < cells; ++cell) {
+        if (!weighted) cell_weights[cell] = static_cast<double>(cell_counts[cell]);
+        std::size_t cx = cell % stride, cy = cell / stride;
+        if (cx == x_axis.bins || cy == histogram.y_axis.bins) {
+            histogram.outside_count += cell_counts[cell];
+            histogram.outside_weight += cell_weights[cell];
+        } else {
+            histogram.counts[cx + cy * x_axis.bins] = cell_counts[cell];
+            histogram.weights[cx + cy * x_axis.bins] = cell_weights[cell];
+        }
+    }
+    return histogram;
+}
+
+/*
+Histogram of the values x, weighted by weights when it is not empty.
+threads == 0 uses every hardware thread.
+*/
+Histogram fill_histogram(const HistogramAxis& x_axis, std::span<const double> x,
+                         std::span<const double> weights = {}, unsigned threads = 0)
+{
+    return fill_histogram_blocks(x.size(), x_axis, nullptr, weights, threads,
+                                 [&](std::size_t begin, std::size_t count, double* x_out, double*) {
+                                     std::memcpy(x_out, x.data() + begin, count * sizeof(double));
+                                 });
+}
+
+// Two-dimensional histogram of the pairs (x[i], y[i]).
+Histogram fill_histogram(const HistogramAxis& x_axis, std::span<const double> x,
+                         const HistogramAxis& y_axis, std::span<const double> y,
+                         std::span<const double> weights = {}, unsigned threads = 0)
+{
+    if (x.size() != y.size()) throw std::invalid_argument("A histogram needs as many x values as y values");
+    return fill_histogram_blocks(x.size(), x_axis, &y_axis, weights, threads,
+                                 [&](std::size_t begin, std::size_t count, double* x_out, double* y_out) {
+                                     std::memcpy(x_out, x.data() + begin, count * sizeof(double));
+                                     std::memcpy(y_out, y.data() + begin, count * sizeof(double));
+                                 });
+}
+
+/*
+Stellar mass function: galaxies of the catalog binned by stellar mass (x) and redshift (y),
+weighted by weights when it is not empty, for example by 1 / Vmax. The stellar masses are
+computed block by block from the catalog columns, never stored. Galaxies without stars have
+log10(0) = -inf and fall outside a log10 mass axis.
+*/
+Histogram stellar_mass_function(const GalaxyCatalog& catalog, const HistogramAxis& mass_axis,
+                                const HistogramAxis& redshift_axis, std::span<const double> weights = {},
+                                unsigned threads = 0)
+{
+    std::span<const double> mass = catalog.get_mass_tot();
+    std::span<const double> fraction = catalog.get_stellar_frac();
+    std::span<const double> redshift = catalog.get_redshift();
+    return fill_histogram_blocks(catalog.size(), mass_axis, &redshift_axis, weights, threads,
+                                 [&](std::size_t begin, std::size_t count, double* x_out, double* y_out) {
+                                     for (std::size_t k = 0; k < count; ++k) {
+                                         x_out[k] = mass[begin + k] * fraction[begin + k];
+                                     }
+                                     std::memcpy(y_out, redshift.data() + begin, count * sizeof(double));
+                                 });
+}
+
+#endif
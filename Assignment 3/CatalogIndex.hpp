@@ -0,0 +1,349 @@
+/*
+This file defines the CatalogIndex class, a secondary index over the redshift and total mass
+columns of a GalaxyCatalog, for range queries that would otherwise scan every galaxy.
+Requires C++20 (std::span).
+*/
+
+#ifndef CATALOG_INDEX_HPP
+#define CATALOG_INDEX_HPP
+
+#include <vector>
+#include <span>
+#include <utility>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "Parallel.hpp"
+#include "GalaxyCatalog.hpp"
+
+// Index of a galaxy in its catalog. 32 bits halve the size of the index.
+typedef std::uint32_t RowId;
+
+// Inclusive range of values. The defaults leave a side open.
+struct ValueRange
+{
+    double min = -std::numeric_limits<double>::infinity();
+    double max = std::numeric_limits<double>::infinity();
+
+    bool contains(double x) const {return x >= min && x <= max;}
+};
+
+/*
+Class name: CatalogIndex
+--------------------
+Description: Indexes the redshift and the total mass of the galaxies of a catalog.
+- For each of the two columns, the row ids sorted by value and the sorted values themselves.
+  A range of one column is two binary searches, and the answer is a span of the sorted ids.
+- For both columns at once, a k-d tree: the points (redshift, mass) are ordered so that every
+  subtree is a contiguous range split at its median, alternately on redshift and on mass, down
+  to leaves of 32 points. A query only visits the cells that meet the query rectangle and
+  copies whole cells that lie inside it without testing their points.
+Construction sorts the two columns and builds the tree at the same time, and the subtrees below
+the first levels are built on separate threads.
+Galaxies appended to the catalog later are added by update(): they are sorted on their own and
+merged into the sorted columns, and they wait in a delta list, scanned by every query, until the
+list is an eighth of the tree and the tree is rebuilt. Queries only see galaxies present at the
+last construction or update(). The index keeps a reference to the catalog, which must outlive it.
+----------------------------------------
+Attributes:
+- catalog: (const GalaxyCatalog&) the indexed catalog.
+- by_redshift, by_mass: (vectors of RowId) row ids sorted by the column.
+- sorted_redshift, sorted_mass: (vectors of double) the column values in the same order.
+- tree: (vector of KdPoint) the points of the k-d tree in tree order.
+- delta: (vector of RowId) rows indexed since the tree was built, not in the tree.
+- rows: number of galaxies indexed.
+----------------------------------------
+Methods:
+- CatalogIndex(const GalaxyCatalog& catalog_in, unsigned threads)
+    Build the index. threads == 0 uses every hardware thread. Throws std::length_error for a
+    catalog with more galaxies than a RowId can count.
+- update(unsigned threads)
+    Index the galaxies appended to the catalog since the last update.
+- redshift_range(ValueRange range), mass_range(ValueRange range)
+    Ids of the galaxies whose value lies in the range, ordered by that value.
+- query(ValueRange redshift, ValueRange mass, std::vector<RowId>& out)
+    Ids of the galaxies inside both ranges, in increasing order. They are stored in out, which is
+    cleared first and can be reused between queries; the returned span views it.
+    When one of the two ranges holds few galaxies (counted with two binary searches in its
+    sorted column) those galaxies are tested directly, otherwise the k-d tree is walked.
+- size()
+    Number of galaxies indexed.
+*/
+class CatalogIndex
+{
+private:
+    struct KdPoint
+    {
+        double redshift;
+        double mass;
+        RowId id;
+    };
+
+    // Cell of the tree: the points in [begin, end) lie inside the bounds.
+    struct Cell
+    {
+        std::size_t begin;
+        std::size_t end;
+        std::size_t depth;
+        ValueRange redshift;
+        ValueRange mass;
+    };
+
+    const GalaxyCatalog& catalog;
+    std::vector<RowId> by_redshift;
+    std::vector<RowId> by_mass;
+    std::vector<double> sorted_redshift;
+    std::vector<double> sorted_mass;
+    std::vector<KdPoint> tree;
+    Cell root{0, 0, 0, {}, {}};
+    std::vector<RowId> delta;
+    std::size_t rows = 0;
+
+    static const std::size_t leaf_size = 32;
+    // A query tests the galaxies of one sorted column instead of walking the tree when that
+    // column matches fewer than 1 / narrow_range_factor of the galaxies.
+    static const std::size_t narrow_range_factor = 64;
+
+    static void sort_column(std::span<const double> values, std::size_t begin, std::size_t end,
+                            std::vector<RowId>& ids, std::vector<double>& sorted);
+    static void build_tree(std::vector<KdPoint>& points, std::size_t begin, std::size_t end, std::size_t depth);
+    void build_tree_parallel(unsigned threads);
+    void query_tree(const Cell& cell, const ValueRange& redshift, const ValueRange& mass,
+                    std::vector<RowId>& out) const;
+    static std::span<const RowId> range_of(const std::vector<RowId>& ids, const std::vector<double>& sorted,
+                                           ValueRange range);
+
+public:
+    CatalogIndex(const GalaxyCatalog& catalog_in, unsigned threads = 0);
+
+    void update(unsigned threads = 0);
+
+    std::span<const RowId> redshift_range(ValueRange range) const {return range_of(by_redshift, sorted_redshift, range);}
+    std::span<const RowId> mass_range(ValueRange range) const {return range_of(by_mass, sorted_mass, range);}
+    std::span<const RowId> query(ValueRange redshift, ValueRange mass, std::vector<RowId>& out) const;
+    std::size_t size() const {return rows;}
+};
+
+CatalogIndex::CatalogIndex(const GalaxyCatalog& catalog_in, unsigned threads) : catalog(catalog_in)
+{
+    update(threads);
+}
+
+/*
+Sort the rows [begin, end) of a column. Pairs of (value, id) are sorted rather than ids through
+the column, so the comparisons read contiguous memory; equal values keep the order of their ids.
+The results are merged into ids and sorted, which already hold the rows before begin.
+*/
+void CatalogIndex::sort_column(std::span<const double> values, std::size_t begin, std::size_t end,
+                               std::vector<RowId>& ids, std::vector<double>& sorted)
+{
+    std::vector<std::pair<double, RowId>> pairs;
+    pairs.reserve(end - begin);
+    for (std::size_t i = begin; i < end; ++i) {
+        pairs.emplace_back(values[i], static_cast<RowId>(i));
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    std::size_t old_size = ids.size();
+    ids.reserve(old_size + pairs.size());
+    sorted.reserve(old_size + pairs.size());
+    for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+        sorted.push_back(it->first);
+        ids.push_back(it->second);
+    }
+    if (old_size == 0) return;
+
+    // The new rows have larger ids than every old row, so merging by value alone keeps ties in id order.
+    std::vector<RowId> merged_ids(ids.size());
+    std::vector<double> merged_values(sorted.size());
+    std::size_t a = 0, b = old_size, k = 0;
+    while (a < old_size && b < ids.size()) {
+        bool take_new = sorted[b] < sorted[a];
+        std::size_t from = take_new ? b++ : a++;
+        merged_values[k] = sorted[from];
+        merged_ids[k++] = ids[from];
+    }
+    for (; a < old_size; ++a, ++k) { merged_values[k] = sorted[a]; merged_ids[k] = ids[a]; }
+    for (; b < ids.size(); ++b, ++k) { merged_values[k] = sorted[b]; merged_ids[k] = ids[b]; }
+    ids.swap(merged_ids);
+    sorted.swap(merged_values);
+}
+
+// Order points [begin, end) as a k-d tree: median in the middle, smaller values before it.
+void CatalogIndex::build_tree(std::vector<KdPoint>& points, std::size_t begin, std::size_t end, std::size_t depth)
+{
+    while (end - begin > leaf_size) {
+        std::size_t mid = begin + (end - begin) / 2;
+        if (depth % 2 == 0) {
+            std::nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end,
+                             [](const KdPoint& a, const KdPoint& b) { return a.redshift < b.redshift; });
+        } else {
+            std::nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end,
+                             [](const KdPoint& a, const KdPoint& b) { return a.mass < b.mass; });
+        }
+        build_tree(points, begin, mid, depth + 1);
+        begin = mid + 1;
+        ++depth;
+    }
+}
+
+/*
+Split the first levels on the calling thread until there is a subtree per thread,
+then build the subtrees on separate threads. Every subtree is a separate range of points.
+*/
+void CatalogIndex::build_tree_parallel(unsigned threads)
+{
+    tree.clear();
+    tree.reserve(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        tree.push_back(KdPoint{catalog.get_redshift()[i], catalog.get_mass_tot()[i], static_cast<RowId>(i)});
+    }
+
+    std::vector<Cell> subtrees{Cell{0, rows, 0, {}, {}}};
+    while (subtrees.size() < threads) {
+        std::vector<Cell> next;
+        for (auto it = subtrees.begin(); it != subtrees.end(); ++it) {
+            if (it->end - it->begin <= leaf_size) {
+                next.push_back(*it);
+                continue;
+            }
+            std::size_t mid = it->begin + (it->end - it->begin) / 2;
+            if (it->depth % 2 == 0) {
+                std::nth_element(tree.begin() + it->begin, tree.begin() + mid, tree.begin() + it->end,
+                                 [](const KdPoint& a, const KdPoint& b) { return a.redshift < b.redshift; });
+            } else {
+                std::nth_element(tree.begin() + it->begin, tree.begin() + mid, tree.begin() + it->end,
+                                 [](const KdPoint& a, const KdPoint& b) { return a.mass < b.mass; });
+            }
+            next.push_back(Cell{it->begin, mid, it->depth + 1, {}, {}});
+            next.push_back(Cell{mid + 1, it->end, it->depth + 1, {}, {}});
+        }
+        if (next.size() == subtrees.size()) break;
+        subtrees.swap(next);
+    }
+
+    parallel_for(subtrees.size(), threads, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            build_tree(tree, subtrees[k].begin, subtrees[k].end, subtrees[k].depth);
+        }
+    });
+    delta.clear();
+
+    // Bounds of the root cell, so that cells on the edges can be found inside a query too.
+    root = Cell{0, rows, 0, {}, {}};
+    if (rows > 0) {
+        auto z = std::minmax_element(catalog.get_redshift().begin(), catalog.get_redshift().begin() + rows);
+        auto m = std::minmax_element(catalog.get_mass_tot().begin(), catalog.get_mass_tot().begin() + rows);
+        root.redshift = ValueRange{*z.first, *z.second};
+        root.mass = ValueRange{*m.first, *m.second};
+    }
+}
+
+void CatalogIndex::update(unsigned threads)
+{
+    const std::size_t n = catalog.size();
+    if (n > std::numeric_limits<RowId>::max()) {
+        throw std::length_error("The catalog has too many galaxies for a CatalogIndex");
+    }
+    if (n == rows) return;
+    if (threads == 0) threads = default_thread_count();
+
+    const std::size_t first_new = rows;
+    rows = n;
+    bool rebuild = tree.empty() || (n - tree.size()) * 8 > tree.size();
+
+    // The two sorts and the tree are independent, so they run at the same time.
+    parallel_for(3, std::min(threads, 3u), [&](std::size_t first, std::size_t last) {
+        for (std::size_t task = first; task < last; ++task) {
+            if (task == 0) sort_column(catalog.get_redshift(), first_new, n, by_redshift, sorted_redshift);
+            else if (task == 1) sort_column(catalog.get_mass_tot(), first_new, n, by_mass, sorted_mass);
+            else if (rebuild) build_tree_parallel(std::max(1u, threads > 3 ? threads - 2 : 1u));
+        }
+    });
+
+    if (!rebuild) {
+        for (std::size_t i = first_new; i < n; ++i) {
+            delta.push_back(static_cast<RowId>(i));
+        }
+    }
+}
+
+std::span<const RowId> CatalogIndex::range_of(const std::vector<RowId>& ids, const std::vector<double>& sorted,
+                                              ValueRange range)
+{
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), range.min);
+    auto last = std::upper_bound(first, sorted.end(), range.max);
+    return std::span<const RowId>(ids.data() + (first - sorted.begin()), static_cast<std::size_t>(last - first));
+}
+
+void CatalogIndex::query_tree(const Cell& cell, const ValueRange& redshift, const ValueRange& mass,
+                              std::vector<RowId>& out) const
+{
+    if (cell.begin >= cell.end) return;
+
+    // The whole cell is inside the query: no point needs testing.
+    if (cell.redshift.min >= redshift.min && cell.redshift.max <= redshift.max &&
+        cell.mass.min >= mass.min && cell.mass.max <= mass.max) {
+        for (std::size_t i = cell.begin; i < cell.end; ++i) {
+            out.push_back(tree[i].id);
+        }
+        return;
+    }
+
+    if (cell.end - cell.begin <= leaf_size) {
+        for (std::size_t i = cell.begin; i < cell.end; ++i) {
+            if (redshift.contains(tree[i].redshift) && mass.contains(tree[i].mass)) out.push_back(tree[i].id);
+        }
+        return;
+    }
+
+    std::size_t mid = cell.begin + (cell.end - cell.begin) / 2;
+    const KdPoint& median = tree[mid];
+    if (redshift.contains(median.redshift) && mass.contains(median.mass)) out.push_back(median.id);
+
+    Cell low = cell, high = cell;
+    low.end = mid;
+    high.begin = mid + 1;
+    low.depth = high.depth = cell.depth + 1;
+    bool split_on_redshift = cell.depth % 2 == 0;
+    double split = split_on_redshift ? median.redshift : median.mass;
+    (split_on_redshift ? low.redshift : low.mass).max = split;
+    (split_on_redshift ? high.redshift : high.mass).min = split;
+
+    const ValueRange& axis = split_on_redshift ? redshift : mass;
+    if (axis.min <= split) query_tree(low, redshift, mass, out);
+    if (axis.max >= split) query_tree(high, redshift, mass, out);
+}
+
+std::span<const RowId> CatalogIndex::query(ValueRange redshift, ValueRange mass, std::vector<RowId>& out) const
+{
+    out.clear();
+    std::span<const RowId> by_z = redshift_range(redshift);
+    std::span<const RowId> by_m = mass_range(mass);
+    std::span<const RowId> narrow = by_z.size() <= by_m.size() ? by_z : by_m;
+
+    if (narrow.size() * narrow_range_factor <= rows) {
+        // One range is narrow enough that testing its galaxies beats walking the tree.
+        std::span<const double> z = catalog.get_redshift();
+        std::span<const double> m = catalog.get_mass_tot();
+        for (auto it = narrow.begin(); it != narrow.end(); ++it) {
+            if (redshift.contains(z[*it]) && mass.contains(m[*it])) out.push_back(*it);
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    query_tree(root, redshift, mass, out);
+
+    std::span<const double> z = catalog.get_redshift();
+    std::span<const double> m = catalog.get_mass_tot();
+    for (auto it = delta.begin(); it != delta.end(); ++it) {
+        if (redshift.contains(z[*it]) && mass.contains(m[*it])) out.push_back(*it);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+#endif
@@ -0,0 +1,446 @@
+/*
+This file defines the CatalogLoader class, which loads galaxy survey files into a GalaxyCatalog.
+The file is memory mapped, cut into chunks of whole lines and parsed on several threads with
+std::from_chars. Invalid rows do not stop the load: they are left out and listed in a report.
+Requires C++20.
+*/
+
+#ifndef CATALOG_LOADER_HPP
+#define CATALOG_LOADER_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+#include "Table.hpp"
+#include "Galaxy.hpp"
+#include "GalaxyCatalog.hpp"
+
+/*
+Layout of a catalog file: one galaxy per line,
+    name, hubble type, redshift, total mass, stellar fraction
+- csv: fields separated by commas, spaces around a field are ignored.
+- whitespace: fields separated by spaces or tabs.
+In both formats a field can be enclosed in double quotes (a name with commas or spaces),
+with "" for a quote inside it. Empty lines and lines starting with '#' are skipped.
+*/
+enum class CatalogFormat { csv, whitespace };
+
+// Why a row was left out.
+enum class RejectReason { field_count, hubble_type, number, redshift, mass_tot, stellar_frac };
+
+std::string reject_reason_name(RejectReason reason)
+{
+    switch (reason) {
+    case RejectReason::field_count: return "Not 5 fields";
+    case RejectReason::hubble_type: return "Invalid hubble type";
+    case RejectReason::number: return "Not a number";
+    case RejectReason::redshift: return "Invalid redshift";
+    case RejectReason::mass_tot: return "Invalid total mass";
+    default: return "Invalid stellar fraction";
+    }
+}
+
+// A row left out of the catalog: its line number (from 1), the reason and the text of the line.
+struct RejectedRow
+{
+    std::size_t line;
+    RejectReason reason;
+    std::string text;
+};
+
+/*
+Result of a load. Every rejected row is counted, the first max_rejected of them are kept
+in file order so a broken file does not fill the memory with copies of its lines.
+*/
+struct CatalogLoadReport
+{
+    std::size_t loaded = 0;
+    std::size_t rejected_count = 0;
+    std::vector<RejectedRow> rejected;
+
+    void display_report(std::ostream& os = std::cout) const;
+};
+
+// Print the counts and the kept rejected rows as a table.
+void CatalogLoadReport::display_report(std::ostream& os) const
+{
+    os << loaded << " galaxies loaded, " << rejected_count << " rows rejected" << std::endl;
+    if (rejected.empty()) return;
+    Table rows({"Line", "Reason", "Text"});
+    rows.reserve_rows(rejected.size());
+    for (auto it = rejected.begin(); it != rejected.end(); ++it) {
+        rows.emplace_row(std::to_string(it->line), reject_reason_name(it->reason), it->text);
+    }
+    rows.display_table(os);
+}
+
+/*
+Class name: CatalogLoader
+--------------------
+Description: Loads catalog files into a GalaxyCatalog. The bytes are cut into chunks that start
+at the beginning of a line, one chunk per thread (chunks are at least 1 MiB). Each chunk is parsed
+into its own columns; the redshift, total mass and stellar fraction columns are then validated
+in one branch-free pass that builds a mask of valid rows, and only the rows that fail are looked at
+again to find the reason. The chunks are appended to the catalog in file order, so the catalog
+and the report are the same for any number of threads.
+Quoted fields must not contain line breaks.
+----------------------------------------
+Attributes:
+- format: (CatalogFormat) how the fields of a line are separated.
+- has_header: the first line that is not empty or a comment holds column names.
+- threads: number of threads, 0 for every hardware thread.
+- max_rejected: number of rejected rows kept in the report.
+----------------------------------------
+Methods:
+- CatalogLoader(CatalogFormat format_in, bool has_header_in, unsigned threads_in, std::size_t max_rejected_in)
+    Constructor.
+- load(const std::string& filename, GalaxyCatalog& catalog)
+    Append the galaxies of a file to the catalog. Throws std::runtime_error if the file cannot be read.
+- load_text(std::string_view text, GalaxyCatalog& catalog)
+    Same as above for text already in memory.
+*/
+class CatalogLoader
+{
+private:
+    // The galaxies and rejected rows of one chunk of the file.
+    struct Chunk
+    {
+        std::string names;
+        std::vector<std::uint64_t> name_ends;
+        std::vector<HubbleType> types;
+        std::vector<double> redshift;
+        std::vector<double> mass_tot;
+        std::vector<double> stellar_frac;
+        std::vector<std::size_t> lines;         // Line of each galaxy, counted from the chunk start.
+        std::vector<RejectedRow> rejected;
+        std::size_t rejected_count = 0;
+        std::size_t line_count = 0;
+    };
+
+    CatalogFormat format;
+    bool has_header;
+    unsigned threads;
+    std::size_t max_rejected;
+
+    // Chunks smaller than this are not worth a thread.
+    static const std::size_t min_chunk_size = 1 << 20;
+
+    const char* read_field(const char* p, const char* end, std::string_view& field, bool& escaped) const;
+    void parse_line(std::string_view line, std::size_t line_number, Chunk& chunk) const;
+    void parse_chunk(const char* begin, const char* end, bool skip_header, Chunk& chunk) const;
+    void validate_chunk(const char* begin, const char* end, Chunk& chunk) const;
+    void reject(Chunk& chunk, std::size_t line_number, RejectReason reason, std::string_view line) const;
+
+public:
+    CatalogLoader(CatalogFormat format_in = CatalogFormat::csv, bool has_header_in = true, unsigned threads_in = 0,
+                  std::size_t max_rejected_in = 1000) :
+        format(format_in), has_header(has_header_in), threads(threads_in), max_rejected(max_rejected_in) {}
+    ~CatalogLoader() {}
+
+    CatalogLoadReport load(const std::string& filename, GalaxyCatalog& catalog) const;
+    CatalogLoadReport load_text(std::string_view text, GalaxyCatalog& catalog) const;
+};
+
+CatalogLoadReport CatalogLoader::load(const std::string& filename, GalaxyCatalog& catalog) const
+{
+    MappedFile file(filename);
+    return load_text(std::string_view(file.data(), file.size()), catalog);
+}
+
+CatalogLoadReport CatalogLoader::load_text(std::string_view text, GalaxyCatalog& catalog) const
+{
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    // Skip a UTF-8 byte order mark.
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) begin += 3;
+
+    // Chunk boundaries, each moved just past the next newline.
+    std::size_t size = static_cast<std::size_t>(end - begin);
+    unsigned n_threads = threads == 0 ? default_thread_count() : threads;
+    std::size_t n_chunks = std::max<std::size_t>(1, std::min<std::size_t>(n_threads, size / min_chunk_size));
+    std::vector<const char*> points{begin};
+    for (std::size_t k = 1; k < n_chunks; ++k) {
+        const char* p = std::max(points.back(), begin + k * (size / n_chunks));
+        p = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (p == nullptr) break;
+        points.push_back(p + 1);
+    }
+    points.push_back(end);
+
+    std::vector<Chunk> chunks(points.size() - 1);
+    parallel_for(chunks.size(), static_cast<unsigned>(chunks.size()), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            parse_chunk(points[k], points[k + 1], has_header && k == 0, chunks[k]);
+            validate_chunk(points[k], points[k + 1], chunks[k]);
+        }
+    });
+
+    // Append the chunks in file order.
+    CatalogLoadReport report;
+    std::size_t total = 0, name_bytes = 0;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        total += it->types.size();
+        name_bytes += it->names.size();
+    }
+    // Grow at least geometrically: an exact reserve would copy the whole catalog again on every
+    // file loaded into it.
+    std::size_t rows_needed = catalog.size() + total, bytes_needed = catalog.names.size() + name_bytes;
+    if (rows_needed > catalog.hubble_types.capacity()) {
+        rows_needed = std::max(rows_needed, 2 * catalog.hubble_types.capacity());
+    }
+    if (bytes_needed > catalog.names.capacity()) {
+        bytes_needed = std::max(bytes_needed, 2 * catalog.names.capacity());
+    }
+    catalog.reserve(rows_needed, bytes_needed);
+
+    std::size_t first_line = 1;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        std::uint64_t name_base = catalog.names.size();
+        catalog.names += it->names;
+        for (auto end_it = it->name_ends.begin(); end_it != it->name_ends.end(); ++end_it) {
+            catalog.name_offsets.push_back(name_base + *end_it);
+        }
+        catalog.hubble_types.insert(catalog.hubble_types.end(), it->types.begin(), it->types.end());
+        catalog.redshift.insert(catalog.redshift.end(), it->redshift.begin(), it->redshift.end());
+        catalog.mass_tot.insert(catalog.mass_tot.end(), it->mass_tot.begin(), it->mass_tot.end());
+        catalog.stellar_frac.insert(catalog.stellar_frac.end(), it->stellar_frac.begin(), it->stellar_frac.end());
+
+        report.rejected_count += it->rejected_count;
+        for (auto row = it->rejected.begin(); row != it->rejected.end() && report.rejected.size() < max_rejected; ++row) {
+            report.rejected.push_back(std::move(*row));
+            report.rejected.back().line += first_line;
+        }
+        first_line += it->line_count;
+    }
+    report.loaded = total;
+    return report;
+}
+
+/*
+Read the field that starts at p, after any spaces, and return where it ends: at its separator,
+after the spaces that follow it, or at the end of the line. A quoted field is returned without its
+quotes and escaped tells whether it still contains doubled quotes.
+*/
+const char* CatalogLoader::read_field(const char* p, const char* end, std::string_view& field, bool& escaped) const
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+    while (p < end && is_space(*p)) ++p;
+
+    escaped = false;
+    if (p < end && *p == '"') {
+        const char* q = p + 1;
+        while (true) {
+            q = static_cast<const char*>(std::memchr(q, '"', static_cast<std::size_t>(end - q)));
+            if (q == nullptr) {
+                // An unterminated quote takes the rest of the line.
+                q = end;
+                break;
+            }
+            if (q + 1 < end && q[1] == '"') { escaped = true; q += 2; continue; }
+            break;
+        }
+        field = std::string_view(p + 1, static_cast<std::size_t>(q - p - 1));
+        p = q < end ? q + 1 : end;
+    } else {
+        const char* q = p;
+        if (format == CatalogFormat::csv) {
+            while (q < end && *q != ',') ++q;
+        } else {
+            while (q < end && !is_space(*q)) ++q;
+        }
+        const char* field_end = q;
+        while (field_end > p && is_space(field_end[-1])) --field_end;
+        field = std::string_view(p, static_cast<std::size_t>(field_end - p));
+        p = q;
+    }
+    while (p < end && is_space(*p)) ++p;
+    return p;
+}
+
+void CatalogLoader::reject(Chunk& chunk, std::size_t line_number, RejectReason reason, std::string_view line) const
+{
+    if (chunk.rejected.size() < max_rejected) {
+        chunk.rejected.push_back(RejectedRow{line_number, reason, std::string(line)});
+    }
+    ++chunk.rejected_count;
+}
+
+// Parse one line into the columns of the chunk, or reject it. Ranges are checked later, in batch.
+void CatalogLoader::parse_line(std::string_view line, std::size_t line_number, Chunk& chunk) const
+{
+    std::string_view fields[5];
+    bool escaped[5];
+    std::size_t n_fields = 0;
+    const char* p = line.data();
+    const char* end = p + line.size();
+    std::string_view field;
+    bool field_escaped = false;
+    // A CSV line has one more field than commas, a whitespace line has one per run of characters.
+    while (n_fields <= 5 && p < end) {
+        p = read_field(p, end, field, field_escaped);
+        if (n_fields < 5) {
+            fields[n_fields] = field;
+            escaped[n_fields] = field_escaped;
+        }
+        ++n_fields;
+        if (format == CatalogFormat::csv) {
+            if (p == end) break;
+            if (*p != ',') {
+                // Text after a closing quote.
+                n_fields = 0;
+                break;
+            }
+            ++p;
+            if (p == end) ++n_fields;
+        }
+    }
+    if (n_fields != 5) {
+        reject(chunk, line_number, RejectReason::field_count, line);
+        return;
+    }
+
+    HubbleType type{};
+    if (!parse_hubble_type(fields[1], type)) {
+        reject(chunk, line_number, RejectReason::hubble_type, line);
+        return;
+    }
+
+    double numbers[3];
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::string_view text = fields[i + 2];
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), numbers[i]);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            reject(chunk, line_number, RejectReason::number, line);
+            return;
+        }
+    }
+
+    if (escaped[0]) {
+        for (std::size_t i = 0; i < fields[0].size(); ++i) {
+            chunk.names += fields[0][i];
+            if (fields[0][i] == '"' && i + 1 < fields[0].size() && fields[0][i + 1] == '"') ++i;
+        }
+    } else {
+        chunk.names.append(fields[0].data(), fields[0].size());
+    }
+    chunk.name_ends.push_back(chunk.names.size());
+    chunk.types.push_back(type);
+    chunk.redshift.push_back(numbers[0]);
+    chunk.mass_tot.push_back(numbers[1]);
+    chunk.stellar_frac.push_back(numbers[2]);
+    chunk.lines.push_back(line_number);
+}
+
+void CatalogLoader::parse_chunk(const char* begin, const char* end, bool skip_header, Chunk& chunk) const
+{
+    // Roughly one galaxy per 64 bytes, so the columns rarely grow.
+    std::size_t expected = static_cast<std::size_t>(end - begin) / 64;
+    chunk.names.reserve(expected * 16);
+    chunk.name_ends.reserve(expected);
+    chunk.types.reserve(expected);
+    chunk.redshift.reserve(expected);
+    chunk.mass_tot.reserve(expected);
+    chunk.stellar_frac.reserve(expected);
+    chunk.lines.reserve(expected);
+
+    const char* p = begin;
+    std::size_t line_number = 0;
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (line_end == nullptr) line_end = end;
+        std::string_view line(p, static_cast<std::size_t>(line_end - p));
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        p = line_end < end ? line_end + 1 : end;
+
+        std::size_t first = line.find_first_not_of(" \t");
+        if (first != std::string_view::npos && line[first] != '#') {
+            if (skip_header) skip_header = false;
+            else parse_line(line, line_number, chunk);
+        }
+        ++line_number;
+    }
+    chunk.line_count = line_number;
+}
+
+/*
+Check the three numeric columns in one pass, with the rules of Galaxy.hpp. The pass only stores
+a mask of valid rows, without a branch per failed check; rows that fail are rejected and removed
+from the columns afterwards. Their lines are found again in the chunk [begin, end) in one
+forward scan.
+*/
+void CatalogLoader::validate_chunk(const char* begin, const char* end, Chunk& chunk) const
+{
+    const std::size_t n = chunk.types.size();
+    std::vector<unsigned char> valid(n);
+    const double* z = chunk.redshift.data();
+    const double* m = chunk.mass_tot.data();
+    const double* f = chunk.stellar_frac.data();
+    std::size_t n_valid = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        valid[i] = is_valid_redshift(z[i]) & is_valid_mass_tot(m[i]) & is_valid_stellar_frac(f[i]);
+        n_valid += valid[i];
+    }
+    if (n_valid == n) return;
+
+    std::vector<RejectedRow> range_errors;
+    const char* line_start = begin;
+    std::size_t line_number = 0;
+    std::size_t kept = 0;
+    std::string names;
+    names.reserve(chunk.names.size());
+    std::uint64_t name_begin = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t name_end = chunk.name_ends[i];
+        if (valid[i]) {
+            names.append(chunk.names, name_begin, name_end - name_begin);
+            chunk.name_ends[kept] = names.size();
+            chunk.types[kept] = chunk.types[i];
+            chunk.redshift[kept] = z[i];
+            chunk.mass_tot[kept] = m[i];
+            chunk.stellar_frac[kept] = f[i];
+            chunk.lines[kept] = chunk.lines[i];
+            ++kept;
+        } else if (range_errors.size() < max_rejected) {
+            auto line_end = [end](const char* p) {
+                const char* q = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+                return q == nullptr ? end : q;
+            };
+            for (; line_number < chunk.lines[i]; ++line_number) {
+                line_start = line_end(line_start) + 1;
+            }
+            std::string_view line(line_start, static_cast<std::size_t>(line_end(line_start) - line_start));
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+            RejectReason reason = !is_valid_redshift(z[i]) ? RejectReason::redshift :
+                                  !is_valid_mass_tot(m[i]) ? RejectReason::mass_tot : RejectReason::stellar_frac;
+            range_errors.push_back(RejectedRow{chunk.lines[i], reason, std::string(line)});
+        }
+        name_begin = name_end;
+    }
+    chunk.names.swap(names);
+    chunk.name_ends.resize(kept);
+    chunk.types.resize(kept);
+    chunk.redshift.resize(kept);
+    chunk.mass_tot.resize(kept);
+    chunk.stellar_frac.resize(kept);
+    chunk.lines.resize(kept);
+
+    // Both lists are in line order; keep the first max_rejected rows of the two together.
+    std::size_t parse_errors = chunk.rejected.size();
+    chunk.rejected.insert(chunk.rejected.end(), range_errors.begin(), range_errors.end());
+    std::inplace_merge(chunk.rejected.begin(), chunk.rejected.begin() + parse_errors, chunk.rejected.end(),
+                       [](const RejectedRow& a, const RejectedRow& b) { return a.line < b.line; });
+    if (chunk.rejected.size() > max_rejected) chunk.rejected.resize(max_rejected);
+    chunk.rejected_count += n - n_valid;
+}
+
+#endif
@@ -17,6 +17,11 @@ Author: Zhiyu Liu, University of Manchester, 2023.3.3
 #include <iomanip>
 #include <numeric>
 #include <sstream>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include "Table.hpp"
 
 // A template function to convert numbers to strings and keep the initial format.
@@ -28,17 +33,96 @@ std::string to_string_format(const T num)
     return oss.str();
 }
 
-// Create an alias for the std::string that represents the hubble types
-typedef std::string HubbleType;
+// The hubble types, one byte each. The values index hubble_type_names.
+enum class HubbleType : std::uint8_t
+{E0, E1, E2, E3, E4, E5, E6, E7,
+ S0, Sa, Sb, Sc, SBa, SBb, SBc, Irr};
 
-// All valid hubble types stored in a vector of strings.
-const std::vector<HubbleType> HubbleTypes
+const std::size_t hubble_type_count = 16;
+
+// Names of the hubble types, in the order of the enum.
+constexpr std::array<std::string_view, hubble_type_count> hubble_type_names
 {"E0", "E1", "E2", "E3", "E4", "E5", "E6", "E7",
  "S0", "Sa", "Sb", "Sc", "SBa", "SBb", "SBc", "Irr"};
 
+constexpr std::string_view hubble_type_name(HubbleType type)
+{
+    return hubble_type_names[static_cast<std::size_t>(type)];
+}
+
+/*
+Parse a hubble type name. The length and the first characters pick the only candidate,
+so no name is compared more than once. Returns false for anything that is not a hubble type.
+*/
+constexpr bool parse_hubble_type(std::string_view str, HubbleType& type)
+{
+    switch (str.size()) {
+    case 2:
+        if (str[0] == 'E' && str[1] >= '0' && str[1] <= '7') {
+            type = static_cast<HubbleType>(static_cast<int>(HubbleType::E0) + (str[1] - '0'));
+            return true;
+        }
+        if (str[0] != 'S') return false;
+        switch (str[1]) {
+        case '0': type = HubbleType::S0; return true;
+        case 'a': type = HubbleType::Sa; return true;
+        case 'b': type = HubbleType::Sb; return true;
+        case 'c': type = HubbleType::Sc; return true;
+        default: return false;
+        }
+    case 3:
+        if (str == "Irr") {
+            type = HubbleType::Irr;
+            return true;
+        }
+        if (str[0] != 'S' || str[1] != 'B') return false;
+        switch (str[2]) {
+        case 'a': type = HubbleType::SBa; return true;
+        case 'b': type = HubbleType::SBb; return true;
+        case 'c': type = HubbleType::SBc; return true;
+        default: return false;
+        }
+    default:
+        return false;
+    }
+}
+
+// Parse a hubble type name, throws std::invalid_argument if it is not one.
+HubbleType hubble_type_from_string(std::string_view str)
+{
+    HubbleType type{};
+    if (!parse_hubble_type(str, type)) {
+        throw std::invalid_argument("Invalid Hubble type: " + std::string(str));
+    }
+    return type;
+}
+
+// Classes of hubble types.
+constexpr bool is_elliptical(HubbleType type) {return type <= HubbleType::E7;}
+constexpr bool is_lenticular(HubbleType type) {return type == HubbleType::S0;}
+constexpr bool is_spiral(HubbleType type) {return type >= HubbleType::Sa && type <= HubbleType::SBc;}
+constexpr bool is_barred(HubbleType type) {return type >= HubbleType::SBa && type <= HubbleType::SBc;}
+constexpr bool is_irregular(HubbleType type) {return type == HubbleType::Irr;}
+
+std::ostream& operator<<(std::ostream& os, HubbleType type)
+{
+    return os << hubble_type_name(type);
+}
+
+// Read one word and parse it, the stream fails if it is not a hubble type.
+std::istream& operator>>(std::istream& is, HubbleType& type)
+{
+    std::string word;
+    if (is >> word && !parse_hubble_type(word, type)) {
+        is.setstate(std::ios::failbit);
+    }
+    return is;
+}
+
 // A series of validation functions
-bool is_valid_hubble_type(const std::string& str) {
-  return std::find(HubbleTypes.begin(), HubbleTypes.end(), str) != HubbleTypes.end();
+bool is_valid_hubble_type(std::string_view str) {
+    HubbleType type{};
+    return parse_hubble_type(str, type);
 }
 
 bool is_valid_redshift(const double redshift) {
@@ -63,7 +147,7 @@ Both constructors validate the attributes.
 ----------------------------------------
 Attibutes:
 - name: (string type) name of the galaxy.
-- hubble_type: (HubbleType type) Hubble type of the galaxy.
+- hubble_type: (HubbleType type) Hubble type of the galaxy, stored in one byte.
 - redshift: (double type) redshift of the galaxy in the range [0, 10].
 - mass_tot: double tpye total mass of the galaxy in the range 1e6-1e13 solar masses.
     (the provided range 1e7-1e12 has been modified)
@@ -78,6 +162,8 @@ Methods:
 - Galaxy(std::string name_in, HubbleType hubble_type_in, double redshift_in, 
            double mass_tot_in, double stellar_frac_in, Galaxy* satellite_in)
     Parameterized constructor. Detailed description can be found in the implementation.
+- Galaxy(std::string name_in, std::string_view hubble_type_in, ...)
+    Same as above with the hubble type given by its name, e.g. "Sc".
 - Galaxy(std::istream&)
     Constructor that takes arguments from the input.
 - ~Galaxy()
@@ -89,7 +175,8 @@ Methods:
 - display_info()
     Display the galaxy information in a tabular form using "Table.hpp"
 - change_type()
-    Change the hubble type of the galaxy.
+    Change the hubble type of the galaxy, given as a HubbleType or by its name.
+    Throws std::invalid_argument for a name that is not a hubble type.
 - add_satellite()
     Add satellites to the galaxy object by passing their addresses.
 */
@@ -109,6 +196,8 @@ public:
     Galaxy() = default;
     Galaxy(std::string name_in, HubbleType hubble_type_in, double redshift_in, 
            double mass_tot_in, double stellar_frac_in, Galaxy* satellite_in);
+    Galaxy(std::string name_in, std::string_view hubble_type_in, double redshift_in, 
+           double mass_tot_in, double stellar_frac_in, Galaxy* satellite_in);
     Galaxy(std::istream&); 
     
     ~Galaxy() {}
@@ -124,12 +213,14 @@ public:
     // Member functions
     void display_info() const;
     void change_type(HubbleType new_type);
+    void change_type(std::string_view new_type);
     void add_satellite(Galaxy* satellite_in);
 };
 
 /*
 Parameterized constructor for the galaxy object.
-The satellites have defualt values nullptr. All attributes except name are validated.
+The satellites have defualt values nullptr. All attributes except name are validated,
+the hubble type is valid by construction.
 */
 Galaxy::Galaxy(std::string name_in, HubbleType hubble_type_in, double redshift_in, 
                double mass_tot_in, double stellar_frac_in, Galaxy* satellite_in=nullptr) : 
@@ -139,11 +230,6 @@ Galaxy::Galaxy(std::string name_in, HubbleType hubble_type_in, double redshift_i
         mass_tot(mass_tot_in), 
         stellar_frac(stellar_frac_in)
 {
-    if (!is_valid_hubble_type(hubble_type_in)) {
-        std::cout << "Invalide Hubble type." << std::endl;
-        throw std::invalid_argument("Invalid input");
-    }
-
     if (!is_valid_redshift(redshift_in)) {
         std::cout << "Invalid redshift." << std::endl;
         throw std::invalid_argument("Invalid input");
@@ -160,6 +246,25 @@ Galaxy::Galaxy(std::string name_in, HubbleType hubble_type_in, double redshift_i
     }
 }
 
+// Hubble type given to a constructor, an invalid one is reported like the other attributes.
+HubbleType validate_hubble_type(std::string_view hubble_type_in)
+{
+    HubbleType type{};
+    if (!parse_hubble_type(hubble_type_in, type)) {
+        std::cout << "Invalide Hubble type." << std::endl;
+        throw std::invalid_argument("Invalid input");
+    }
+    return type;
+}
+
+// Parameterized constructor with the name of the hubble type, which is validated first.
+Galaxy::Galaxy(std::string name_in, std::string_view hubble_type_in, double redshift_in, 
+               double mass_tot_in, double stellar_frac_in, Galaxy* satellite_in=nullptr) : 
+        Galaxy(std::move(name_in), validate_hubble_type(hubble_type_in), 
+               redshift_in, mass_tot_in, stellar_frac_in, satellite_in)
+{
+}
+
 // friend of the Galaxy class that initializes the object passed by the constructor.
 std::istream& read_input(std::istream& input_stream, Galaxy& galaxy_in)
 {
@@ -167,7 +272,7 @@ std::istream& read_input(std::istream& input_stream, Galaxy& galaxy_in)
     std::getline(input_stream, galaxy_in.name);
 
     std::cout << "Please enter the type of the galaxy: ";
-    while (!(input_stream >> galaxy_in.hubble_type) || !is_valid_hubble_type(galaxy_in.hubble_type)) {
+    while (!(input_stream >> galaxy_in.hubble_type)) {
         std::cout << "Invalid hubble type, please enter again: ";
         input_stream.clear();
         input_stream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
@@ -206,7 +311,7 @@ void Galaxy::display_info() const
 {
     std::vector<std::string> headers{"Name", "Type", "Redshift", "Total mass", "Stellar fraction"};
     std::vector<std::vector<std::string>> rows;
-    std::vector<std::string> row{name, hubble_type, 
+    std::vector<std::string> row{name, std::string(hubble_type_name(hubble_type)), 
                             to_string_format(redshift),
                             to_string_format(mass_tot), 
                             to_string_format(stellar_frac)};
@@ -225,7 +330,7 @@ void Galaxy::display_info() const
         oss_satellite << "of " << name;
 
         for (auto it = satellites.begin(); it != satellites.end(); ++it) {
-            std::vector<std::string> more_row{(*it)->name, (*it)->hubble_type, 
+            std::vector<std::string> more_row{(*it)->name, std::string(hubble_type_name((*it)->hubble_type)), 
                                             to_string_format((*it)->redshift),
                                             to_string_format((*it)->mass_tot),
                                             to_string_format((*it)->stellar_frac),
@@ -242,6 +347,11 @@ void Galaxy::change_type(HubbleType new_type)
     this->hubble_type = new_type;
 }
 
+void Galaxy::change_type(std::string_view new_type)
+{
+    this->hubble_type = hubble_type_from_string(new_type);
+}
+
 inline double Galaxy::get_stellar_mass() const
 {
     return this->stellar_frac * this->mass_tot;
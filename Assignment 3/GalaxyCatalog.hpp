@@ -0,0 +1,296 @@
+/*
+This file defines the GalaxyCatalog class, a catalog of many galaxies stored column by column,
+and GalaxyRef, a lightweight view of one galaxy of the catalog.
+A Galaxy object owns its name, its type and a vector of satellites, so millions of them mean
+millions of small allocations; the catalog keeps each attribute in one contiguous array instead.
+Requires C++20 (std::span).
+*/
+
+#ifndef GALAXY_CATALOG_HPP
+#define GALAXY_CATALOG_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include "Table.hpp"
+#include "Galaxy.hpp"
+
+// Hubble types of a bulk append can be given as HubbleType values or by their names.
+HubbleType to_hubble_type(HubbleType type) {return type;}
+HubbleType to_hubble_type(std::string_view type) {return hubble_type_from_string(type);}
+
+class GalaxyCatalog;
+
+/*
+Class name: GalaxyRef
+--------------------
+Description: One galaxy of a GalaxyCatalog, read in place. It holds a pointer to the catalog
+and an index, so it is as cheap to copy as an iterator and stays valid while the catalog lives
+(rows are never removed). The getters are those of Galaxy.
+----------------------------------------
+Methods:
+- get_index(), get_name(), get_hubble_type(), get_redshift(),
+  get_mass_tot(), get_stellar_frac(), get_stellar_mass()
+    Getters.
+- to_galaxy()
+    A standalone Galaxy with the same attributes and no satellites.
+*/
+class GalaxyRef
+{
+private:
+    const GalaxyCatalog* catalog;
+    std::size_t index;
+
+public:
+    GalaxyRef(const GalaxyCatalog& catalog_in, std::size_t index_in) : catalog(&catalog_in), index(index_in) {}
+    ~GalaxyRef() {}
+
+    std::size_t get_index() const {return index;}
+    std::string_view get_name() const;
+    HubbleType get_hubble_type() const;
+    double get_redshift() const;
+    double get_mass_tot() const;
+    double get_stellar_frac() const;
+    double get_stellar_mass() const {return get_stellar_frac() * get_mass_tot();}
+
+    Galaxy to_galaxy() const;
+};
+
+/*
+Class name: GalaxyCatalog
+--------------------
+Description: A catalog of galaxies stored as one column per attribute.
+Names are kept back to back in a single character arena and found through an offset column;
+Hubble types are a column of one byte HubbleType values. Every galaxy is validated with the same rules
+as the Galaxy constructor, but an invalid galaxy throws without printing, and a bulk append
+checks every row before adding any, so a failed append leaves the catalog unchanged.
+----------------------------------------
+Attributes:
+- names: (string) every name, back to back.
+- name_offsets: (vector of uint64) name i is names[name_offsets[i], name_offsets[i + 1]).
+- hubble_types: (vector of HubbleType) Hubble type of each galaxy.
+- redshift, mass_tot, stellar_frac: (vectors of double) the numeric columns.
+----------------------------------------
+Methods:
+- GalaxyCatalog()
+    An empty catalog.
+- reserve(std::size_t n, std::size_t name_bytes)
+    Reserve space for n galaxies and name_bytes characters of names.
+- append(std::string_view name, HubbleType hubble_type, double redshift, double mass_tot, double stellar_frac)
+- append(std::string_view name, std::string_view hubble_type, double redshift, double mass_tot, double stellar_frac)
+- append(const Galaxy& galaxy)
+    Add one galaxy and return its index. Throws std::invalid_argument for an invalid attribute.
+- append_columns(names, hubble_types, redshifts, mass_tots, stellar_fracs)
+    Add many galaxies given as columns of the same length. Hubble types are HubbleType values or
+    names. Throws std::invalid_argument, naming
+    the first invalid row, before anything is added.
+- size(), operator[](std::size_t i), at(std::size_t i)
+    Number of galaxies and the GalaxyRef of galaxy i (at() checks the index).
+- name(i), hubble_type(i)
+    Name and Hubble type of galaxy i.
+- get_redshift(), get_mass_tot(), get_stellar_frac(), get_hubble_types()
+    The columns as read-only spans.
+- get_names(), get_name_offsets()
+    The name arena and its offset column, size() + 1 values starting at 0.
+- get_stellar_mass(), get_stellar_mass(std::span<double> out)
+    The stellar mass of every galaxy, returned or written into out (which must hold size() values).
+- display_info(std::size_t begin, std::size_t end, std::ostream& os)
+    Print galaxies [begin, end) in the table format of Galaxy::display_info().
+*/
+class GalaxyCatalog
+{
+friend class CatalogLoader;
+friend class CatalogFile;
+private:
+    std::string names;
+    std::vector<std::uint64_t> name_offsets{0};
+    std::vector<HubbleType> hubble_types;
+    std::vector<double> redshift;
+    std::vector<double> mass_tot;
+    std::vector<double> stellar_frac;
+
+    void push_back(std::string_view name, HubbleType hubble_type_in, double redshift_in, double mass_tot_in,
+                   double stellar_frac_in);
+
+public:
+    GalaxyCatalog() = default;
+
+    void reserve(std::size_t n, std::size_t name_bytes = 0);
+    std::size_t append(std::string_view name, HubbleType hubble_type_in, double redshift_in,
+                       double mass_tot_in, double stellar_frac_in);
+    std::size_t append(std::string_view name, std::string_view hubble_type_in, double redshift_in,
+                       double mass_tot_in, double stellar_frac_in);
+    std::size_t append(const Galaxy& galaxy);
+    template <typename Names, typename Types>
+    void append_columns(const Names& names_in, const Types& hubble_types_in, std::span<const double> redshifts,
+                        std::span<const double> mass_tots, std::span<const double> stellar_fracs);
+
+    std::size_t size() const {return hubble_types.size();}
+    GalaxyRef operator[](std::size_t i) const {return GalaxyRef(*this, i);}
+    GalaxyRef at(std::size_t i) const;
+
+    std::string_view name(std::size_t i) const
+    {
+        return std::string_view(names.data() + name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+    }
+    HubbleType hubble_type(std::size_t i) const {return hubble_types[i];}
+
+    std::span<const double> get_redshift() const {return redshift;}
+    std::span<const double> get_mass_tot() const {return mass_tot;}
+    std::span<const double> get_stellar_frac() const {return stellar_frac;}
+    std::span<const HubbleType> get_hubble_types() const {return hubble_types;}
+    std::string_view get_names() const {return names;}
+    std::span<const std::uint64_t> get_name_offsets() const {return name_offsets;}
+
+    std::vector<double> get_stellar_mass() const;
+    void get_stellar_mass(std::span<double> out) const;
+
+    void display_info(std::size_t begin, std::size_t end, std::ostream& os = std::cout) const;
+};
+
+std::string_view GalaxyRef::get_name() const {return catalog->name(index);}
+HubbleType GalaxyRef::get_hubble_type() const {return catalog->hubble_type(index);}
+double GalaxyRef::get_redshift() const {return catalog->get_redshift()[index];}
+double GalaxyRef::get_mass_tot() const {return catalog->get_mass_tot()[index];}
+double GalaxyRef::get_stellar_frac() const {return catalog->get_stellar_frac()[index];}
+
+Galaxy GalaxyRef::to_galaxy() const
+{
+    return Galaxy(std::string(get_name()), get_hubble_type(), get_redshift(), get_mass_tot(), get_stellar_frac());
+}
+
+void GalaxyCatalog::reserve(std::size_t n, std::size_t name_bytes)
+{
+    names.reserve(name_bytes);
+    name_offsets.reserve(n + 1);
+    hubble_types.reserve(n);
+    redshift.reserve(n);
+    mass_tot.reserve(n);
+    stellar_frac.reserve(n);
+}
+
+void GalaxyCatalog::push_back(std::string_view name, HubbleType hubble_type_in, double redshift_in, double mass_tot_in,
+                              double stellar_frac_in)
+{
+    names.append(name.data(), name.size());
+    name_offsets.push_back(names.size());
+    hubble_types.push_back(hubble_type_in);
+    redshift.push_back(redshift_in);
+    mass_tot.push_back(mass_tot_in);
+    stellar_frac.push_back(stellar_frac_in);
+}
+
+std::size_t GalaxyCatalog::append(std::string_view name, HubbleType hubble_type_in, double redshift_in,
+                                  double mass_tot_in, double stellar_frac_in)
+{
+    if (!is_valid_redshift(redshift_in)) throw std::invalid_argument("Invalid redshift");
+    if (!is_valid_mass_tot(mass_tot_in)) throw std::invalid_argument("Invalid total mass");
+    if (!is_valid_stellar_frac(stellar_frac_in)) throw std::invalid_argument("Invalid stellar fraction");
+    push_back(name, hubble_type_in, redshift_in, mass_tot_in, stellar_frac_in);
+    return size() - 1;
+}
+
+std::size_t GalaxyCatalog::append(std::string_view name, std::string_view hubble_type_in, double redshift_in,
+                                  double mass_tot_in, double stellar_frac_in)
+{
+    return append(name, hubble_type_from_string(hubble_type_in), redshift_in, mass_tot_in, stellar_frac_in);
+}
+
+std::size_t GalaxyCatalog::append(const Galaxy& galaxy)
+{
+    return append(galaxy.get_name(), galaxy.get_hubble_type(), galaxy.get_redshift(), galaxy.get_mass_tot(),
+                  galaxy.get_stellar_frac());
+}
+
+/*
+The three numeric columns are checked in one branch-free pass that only ORs comparison results
+together; only if a row failed does a slow second pass look at the rows one by one to name the
+first invalid row. Names and Hubble types can be any containers of strings or string views.
+*/
+template <typename Names, typename Types>
+void GalaxyCatalog::append_columns(const Names& names_in, const Types& hubble_types_in,
+                                   std::span<const double> redshifts, std::span<const double> mass_tots,
+                                   std::span<const double> stellar_fracs)
+{
+    const std::size_t n = redshifts.size();
+    if (names_in.size() != n || hubble_types_in.size() != n || mass_tots.size() != n || stellar_fracs.size() != n) {
+        throw std::invalid_argument("Columns of different lengths");
+    }
+
+    std::vector<HubbleType> types(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        types[i] = to_hubble_type(hubble_types_in[i]);
+    }
+
+    bool any_invalid = false;
+    for (std::size_t i = 0; i < n; ++i) {
+        any_invalid |= !is_valid_redshift(redshifts[i]) | !is_valid_mass_tot(mass_tots[i]) |
+                       !is_valid_stellar_frac(stellar_fracs[i]);
+    }
+    if (any_invalid) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!is_valid_redshift(redshifts[i]) || !is_valid_mass_tot(mass_tots[i]) ||
+                !is_valid_stellar_frac(stellar_fracs[i])) {
+                throw std::invalid_argument("Invalid galaxy in row " + std::to_string(i));
+            }
+        }
+    }
+
+    // No exact reserve here: repeated appends would then reallocate every time.
+    for (std::size_t i = 0; i < n; ++i) {
+        names.append(std::string_view(names_in[i]));
+        name_offsets.push_back(names.size());
+    }
+    hubble_types.insert(hubble_types.end(), types.begin(), types.end());
+    redshift.insert(redshift.end(), redshifts.begin(), redshifts.end());
+    mass_tot.insert(mass_tot.end(), mass_tots.begin(), mass_tots.end());
+    stellar_frac.insert(stellar_frac.end(), stellar_fracs.begin(), stellar_fracs.end());
+}
+
+GalaxyRef GalaxyCatalog::at(std::size_t i) const
+{
+    if (i >= size()) {
+        throw std::out_of_range("Galaxy " + std::to_string(i) + " does not exist, the catalog has " +
+                                std::to_string(size()) + " galaxies");
+    }
+    return GalaxyRef(*this, i);
+}
+
+// M = stellar fraction * total mass, over contiguous columns so the loop is vectorized.
+void GalaxyCatalog::get_stellar_mass(std::span<double> out) const
+{
+    if (out.size() < size()) throw std::invalid_argument("Output span is shorter than the catalog");
+    const double* fraction = stellar_frac.data();
+    const double* mass = mass_tot.data();
+    double* result = out.data();
+    for (std::size_t i = 0; i < size(); ++i) {
+        result[i] = fraction[i] * mass[i];
+    }
+}
+
+std::vector<double> GalaxyCatalog::get_stellar_mass() const
+{
+    std::vector<double> result(size());
+    get_stellar_mass(result);
+    return result;
+}
+
+void GalaxyCatalog::display_info(std::size_t begin, std::size_t end, std::ostream& os) const
+{
+    end = std::min(end, size());
+    Table info({"Name", "Type", "Redshift", "Total mass", "Stellar fraction"});
+    info.reserve_rows(end > begin ? end - begin : 0);
+    for (std::size_t i = begin; i < end; ++i) {
+        info.emplace_row(name(i), hubble_type_name(hubble_types[i]), to_string_format(redshift[i]), to_string_format(mass_tot[i]),
+                         to_string_format(stellar_frac[i]));
+    }
+    info.display_table(os);
+}
+
+#endif
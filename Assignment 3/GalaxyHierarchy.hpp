@@ -0,0 +1,376 @@
+/*
+This file defines the GalaxyHierarchy class, which links the galaxies of a GalaxyCatalog into
+trees of hosts and satellites with plain index arrays instead of Galaxy* pointers, and sums the
+masses of whole subtrees. Requires C++20 (std::span).
+*/
+
+#ifndef GALAXY_HIERARCHY_HPP
+#define GALAXY_HIERARCHY_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "Parallel.hpp"
+#include "Table.hpp"
+#include "GalaxyCatalog.hpp"
+#include "CatalogIndex.hpp"
+
+// Parent of a galaxy that is not a satellite, end of a list of children.
+const RowId no_galaxy = UINT32_MAX;
+
+// Totals over a galaxy and all its satellites, down to the last level.
+struct SubtreeTotals
+{
+    std::size_t galaxies = 0;
+    double mass_tot = 0;
+    double stellar_mass = 0;
+};
+
+/*
+Class name: GalaxyHierarchy
+--------------------
+Description: Host/satellite trees over the galaxies of a catalog, one entry per galaxy in each
+of three arrays: the parent, the first child and the next sibling. Links are indices, so the
+hierarchy is three allocations whatever its shape, and it never points to freed galaxies.
+For aggregates the hierarchy keeps a layout in preorder: every subtree is a contiguous range of
+positions, and the total and stellar masses are copied in that order, so the totals of a subtree
+are a sum over one contiguous range, O(subtree size). The layout is rebuilt in O(n) by the
+first query after the links changed.
+----------------------------------------
+Attributes:
+- catalog: (const GalaxyCatalog&) the galaxies.
+- parent, first_child, next_sibling: (vectors of RowId) the links, no_galaxy for none.
+- preorder: (vector of RowId) the galaxies in preorder, trees in the order of their roots.
+- position, subtree_size: (vectors of RowId) where each galaxy is in preorder and the size of its subtree.
+- ordered_mass, ordered_stellar_mass: (vectors of double) total and stellar mass in preorder.
+- layout_valid: the preorder layout matches the links.
+----------------------------------------
+Methods:
+- GalaxyHierarchy(const GalaxyCatalog& catalog_in)
+    Every galaxy of the catalog starts as a root.
+- update()
+    Add the galaxies appended to the catalog since, as roots.
+- set_parent(RowId child, RowId new_parent), reparent(std::span<const RowId> children, RowId new_parent)
+    Make galaxies satellites of new_parent, or roots with no_galaxy. A bulk reparent checks all
+    the moves first and costs O(moved galaxies + siblings they leave + depth of new_parent).
+    Throws std::invalid_argument for an id out of range or a move that would make a cycle.
+- set_parents(std::span<const RowId> parents_in)
+    Replace every link at once from a column of parents, one per galaxy, in O(n). Siblings
+    are listed in increasing id order. Throws std::invalid_argument, without changing the
+    hierarchy, for a parent out of range or parents that make a cycle.
+- get_parent(i), get_first_child(i), get_next_sibling(i), get_roots(), depth(i)
+    Navigation.
+- get_parents()
+    The parent column.
+- subtree(RowId root)
+    The galaxies of a subtree in preorder, root first.
+- subtree_totals(RowId root)
+    Number of galaxies, total mass and stellar mass of a subtree.
+- all_subtree_totals(unsigned threads)
+    The totals of every subtree, computed bottom-up in one pass. Separate trees are reduced on
+    separate threads (threads == 0 uses every hardware thread).
+- display_subtree(RowId root, std::ostream& os)
+    Print a subtree in the table format of Galaxy::display_info(), with each galaxy's host.
+*/
+class GalaxyHierarchy
+{
+private:
+    const GalaxyCatalog& catalog;
+    std::vector<RowId> parent;
+    std::vector<RowId> first_child;
+    std::vector<RowId> next_sibling;
+
+    std::vector<RowId> preorder;
+    std::vector<RowId> position;
+    std::vector<RowId> subtree_size;
+    std::vector<double> ordered_mass;
+    std::vector<double> ordered_stellar_mass;
+    bool layout_valid = false;
+
+    std::vector<char> moving;       // Marks the galaxies of a reparent, all 0 between calls.
+
+    void check_id(RowId i) const;
+    void update_layout();
+
+public:
+    GalaxyHierarchy(const GalaxyCatalog& catalog_in);
+
+    void update();
+    void set_parent(RowId child, RowId new_parent) {reparent(std::span<const RowId>(&child, 1), new_parent);}
+    void reparent(std::span<const RowId> children, RowId new_parent);
+    void set_parents(std::span<const RowId> parents_in);
+
+    RowId get_parent(RowId i) const {return parent[i];}
+    RowId get_first_child(RowId i) const {return first_child[i];}
+    RowId get_next_sibling(RowId i) const {return next_sibling[i];}
+    std::span<const RowId> get_parents() const {return parent;}
+    std::vector<RowId> get_roots() const;
+    std::size_t depth(RowId i) const;
+
+    std::span<const RowId> subtree(RowId root);
+    SubtreeTotals subtree_totals(RowId root);
+    std::vector<SubtreeTotals> all_subtree_totals(unsigned threads = 0);
+    void display_subtree(RowId root, std::ostream& os = std::cout);
+};
+
+GalaxyHierarchy::GalaxyHierarchy(const GalaxyCatalog& catalog_in) : catalog(catalog_in)
+{
+    update();
+}
+
+void GalaxyHierarchy::update()
+{
+    if (catalog.size() > no_galaxy) {
+        throw std::length_error("The catalog has too many galaxies for a GalaxyHierarchy");
+    }
+    if (catalog.size() == parent.size()) return;
+    parent.resize(catalog.size(), no_galaxy);
+    first_child.resize(catalog.size(), no_galaxy);
+    next_sibling.resize(catalog.size(), no_galaxy);
+    moving.resize(catalog.size(), 0);
+    layout_valid = false;
+}
+
+void GalaxyHierarchy::check_id(RowId i) const
+{
+    if (i >= parent.size()) {
+        throw std::invalid_argument("Galaxy " + std::to_string(i) + " is not in the hierarchy");
+    }
+}
+
+/*
+Validate every move before changing a link. A move makes a cycle exactly when new_parent lies
+in the subtree of a moved galaxy, that is when a moved galaxy is new_parent or one of its
+ancestors, so a single walk up from new_parent checks the whole batch.
+Each old parent's list of children is then filtered once, whatever the number of children
+it loses, and the moved galaxies are put in front of the list of new_parent.
+*/
+void GalaxyHierarchy::reparent(std::span<const RowId> children, RowId new_parent)
+{
+    if (new_parent != no_galaxy) check_id(new_parent);
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        check_id(*it);
+    }
+
+    for (auto it = children.begin(); it != children.end(); ++it) moving[*it] = 1;
+    bool cycle = false;
+    for (RowId a = new_parent; a != no_galaxy && !cycle; a = parent[a]) {
+        cycle = moving[a] != 0;
+    }
+    if (cycle) {
+        for (auto it = children.begin(); it != children.end(); ++it) moving[*it] = 0;
+        throw std::invalid_argument("A galaxy cannot become a satellite of its own satellite");
+    }
+
+    // Unlink from the old parents. A parent is filtered by its first moved child only.
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        RowId old_parent = parent[*it];
+        if (old_parent == no_galaxy || moving[*it] != 1) continue;
+        RowId* link = &first_child[old_parent];
+        while (*link != no_galaxy) {
+            if (moving[*link]) {
+                moving[*link] = 2;      // Already unlinked.
+                *link = next_sibling[*link];
+            } else {
+                link = &next_sibling[*link];
+            }
+        }
+    }
+
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        if (moving[*it] == 0) continue;     // Listed twice.
+        moving[*it] = 0;
+        parent[*it] = new_parent;
+        next_sibling[*it] = no_galaxy;
+        if (new_parent != no_galaxy) {
+            next_sibling[*it] = first_child[new_parent];
+            first_child[new_parent] = *it;
+        }
+    }
+    layout_valid = false;
+}
+
+/*
+Build the child lists backwards, so each is in increasing id order. Galaxies on a cycle have
+no root above them, so the links are valid exactly when a walk from the roots reaches all of them.
+*/
+void GalaxyHierarchy::set_parents(std::span<const RowId> parents_in)
+{
+    const std::size_t n = parent.size();
+    if (parents_in.size() != n) throw std::invalid_argument("set_parents needs one parent per galaxy");
+    for (auto it = parents_in.begin(); it != parents_in.end(); ++it) {
+        if (*it != no_galaxy) check_id(*it);
+    }
+
+    std::vector<RowId> new_first_child(n, no_galaxy), new_next_sibling(n, no_galaxy);
+    for (std::size_t i = n; i-- > 0;) {
+        RowId p = parents_in[i];
+        if (p != no_galaxy) {
+            new_next_sibling[i] = new_first_child[p];
+            new_first_child[p] = static_cast<RowId>(i);
+        }
+    }
+
+    std::size_t reached = 0;
+    std::vector<RowId> stack;
+    for (std::size_t root = 0; root < n; ++root) {
+        if (parents_in[root] != no_galaxy) continue;
+        stack.push_back(static_cast<RowId>(root));
+        while (!stack.empty()) {
+            RowId g = stack.back();
+            stack.pop_back();
+            ++reached;
+            for (RowId c = new_first_child[g]; c != no_galaxy; c = new_next_sibling[c]) {
+                stack.push_back(c);
+            }
+        }
+    }
+    if (reached != n) throw std::invalid_argument("The parents make a cycle");
+
+    parent.assign(parents_in.begin(), parents_in.end());
+    first_child.swap(new_first_child);
+    next_sibling.swap(new_next_sibling);
+    layout_valid = false;
+}
+
+std::vector<RowId> GalaxyHierarchy::get_roots() const
+{
+    std::vector<RowId> roots;
+    for (std::size_t i = 0; i < parent.size(); ++i) {
+        if (parent[i] == no_galaxy) roots.push_back(static_cast<RowId>(i));
+    }
+    return roots;
+}
+
+std::size_t GalaxyHierarchy::depth(RowId i) const
+{
+    std::size_t d = 0;
+    for (RowId a = parent[i]; a != no_galaxy; a = parent[a]) ++d;
+    return d;
+}
+
+/*
+Lay the trees out in preorder with an explicit stack, then compute the subtree sizes in
+reverse preorder, where every galaxy comes after all of its satellites.
+*/
+void GalaxyHierarchy::update_layout()
+{
+    if (layout_valid) return;
+    const std::size_t n = parent.size();
+    preorder.clear();
+    preorder.reserve(n);
+    position.resize(n);
+    subtree_size.assign(n, 1);
+
+    std::vector<RowId> stack;
+    for (std::size_t root = 0; root < n; ++root) {
+        if (parent[root] != no_galaxy) continue;
+        stack.push_back(static_cast<RowId>(root));
+        while (!stack.empty()) {
+            RowId g = stack.back();
+            stack.pop_back();
+            position[g] = static_cast<RowId>(preorder.size());
+            preorder.push_back(g);
+            // Pushed in list order, so the last child is visited first; any fixed order will do.
+            for (RowId c = first_child[g]; c != no_galaxy; c = next_sibling[c]) {
+                stack.push_back(c);
+            }
+        }
+    }
+    for (std::size_t k = n; k-- > 0;) {
+        RowId g = preorder[k];
+        if (parent[g] != no_galaxy) subtree_size[parent[g]] += subtree_size[g];
+    }
+
+    std::span<const double> mass = catalog.get_mass_tot();
+    std::span<const double> fraction = catalog.get_stellar_frac();
+    ordered_mass.resize(n);
+    ordered_stellar_mass.resize(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        ordered_mass[k] = mass[preorder[k]];
+        ordered_stellar_mass[k] = mass[preorder[k]] * fraction[preorder[k]];
+    }
+    layout_valid = true;
+}
+
+std::span<const RowId> GalaxyHierarchy::subtree(RowId root)
+{
+    check_id(root);
+    update_layout();
+    return std::span<const RowId>(preorder.data() + position[root], subtree_size[root]);
+}
+
+SubtreeTotals GalaxyHierarchy::subtree_totals(RowId root)
+{
+    check_id(root);
+    update_layout();
+    SubtreeTotals totals;
+    std::size_t begin = position[root], end = begin + subtree_size[root];
+    totals.galaxies = end - begin;
+    for (std::size_t k = begin; k < end; ++k) {
+        totals.mass_tot += ordered_mass[k];
+        totals.stellar_mass += ordered_stellar_mass[k];
+    }
+    return totals;
+}
+
+/*
+Bottom-up reduction: in reverse preorder every galaxy adds its totals to its parent's.
+Separate trees occupy separate ranges of the layout, so the trees are split into groups of
+about the same number of galaxies and each group is reduced by its own thread.
+*/
+std::vector<SubtreeTotals> GalaxyHierarchy::all_subtree_totals(unsigned threads)
+{
+    update_layout();
+    const std::size_t n = parent.size();
+    std::vector<SubtreeTotals> totals(n);
+    if (threads == 0) threads = default_thread_count();
+
+    // Group boundaries, in layout positions, each at the start of a tree.
+    std::vector<std::size_t> bounds{0};
+    for (std::size_t k = 0; k < n; k += subtree_size[preorder[k]]) {
+        if (k >= bounds.size() * n / threads && k > bounds.back()) bounds.push_back(k);
+    }
+    bounds.push_back(n);
+
+    parallel_for(bounds.size() - 1, threads, [&](std::size_t first, std::size_t last) {
+        for (std::size_t group = first; group < last; ++group) {
+            for (std::size_t k = bounds[group + 1]; k-- > bounds[group];) {
+                RowId g = preorder[k];
+                SubtreeTotals& t = totals[g];
+                t.galaxies += 1;
+                t.mass_tot += ordered_mass[k];
+                t.stellar_mass += ordered_stellar_mass[k];
+                if (parent[g] != no_galaxy) {
+                    SubtreeTotals& p = totals[parent[g]];
+                    p.galaxies += t.galaxies;
+                    p.mass_tot += t.mass_tot;
+                    p.stellar_mass += t.stellar_mass;
+                }
+            }
+        }
+    });
+    return totals;
+}
+
+void GalaxyHierarchy::display_subtree(RowId root, std::ostream& os)
+{
+    std::span<const RowId> galaxies = subtree(root);
+    Table info({"Name", "Type", "Redshift", "Total mass", "Stellar fraction", "Host"});
+    info.reserve_rows(galaxies.size());
+    for (auto it = galaxies.begin(); it != galaxies.end(); ++it) {
+        GalaxyRef g = catalog[*it];
+        std::string host = parent[*it] == no_galaxy ? "" : "of " + std::string(catalog.name(parent[*it]));
+        info.emplace_row(std::string(g.get_name()), std::string(hubble_type_name(g.get_hubble_type())),
+                         to_string_format(g.get_redshift()), to_string_format(g.get_mass_tot()),
+                         to_string_format(g.get_stellar_frac()), host);
+    }
+    info.display_table(os);
+}
+
+#endif
@@ -0,0 +1,514 @@
+/*
++-----------------------------------------------------+
+| Benchmarks for the galaxy catalog classes           |
++-----------------------------------------------------+
+Build:  g++ -std=c++20 -O3 -pthread benchmark.cpp -o benchmark
+Usage:  ./benchmark [name]
+Without a name every benchmark is run. The results are printed with Table.hpp.
+Heap allocations are counted by replacing the global operator new.
+*/
+#include "Table.hpp"
+#include "Galaxy.hpp"
+#include "GalaxyCatalog.hpp"
+#include "CatalogLoader.hpp"
+#include "CatalogIndex.hpp"
+#include "GalaxyHierarchy.hpp"
+#include "CatalogHistogram.hpp"
+#include "CatalogFile.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Number of calls to operator new since the start of the program.
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc{};
+}
+
+// Out of line, so the compiler does not pair the inlined free() with the builtin operator new.
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Time a callable and return the elapsed wall time in milliseconds.
+template <typename F>
+double time_ms(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Run a callable and return the number of heap allocations it made.
+template <typename F>
+std::size_t count_allocations(F&& f)
+{
+    std::size_t before = allocation_count;
+    f();
+    return allocation_count - before;
+}
+
+// Random but valid galaxies, given as columns.
+struct GalaxyColumns
+{
+    std::vector<std::string> names;
+    std::vector<std::string> types;
+    std::vector<double> redshift;
+    std::vector<double> mass_tot;
+    std::vector<double> stellar_frac;
+};
+
+GalaxyColumns make_galaxies(std::size_t n)
+{
+    std::mt19937_64 generator{1};
+    std::uniform_real_distribution<double> redshift{0.0, 10.0};
+    std::uniform_real_distribution<double> log_mass{6.0, 13.0};
+    std::uniform_real_distribution<double> fraction{0.0, 0.05};
+    std::uniform_int_distribution<std::size_t> type{0, hubble_type_count - 1};
+
+    GalaxyColumns columns;
+    for (std::size_t i = 0; i < n; ++i) {
+        columns.names.push_back("Galaxy catalog entry " + std::to_string(i));
+        columns.types.emplace_back(hubble_type_names[type(generator)]);
+        columns.redshift.push_back(redshift(generator));
+        columns.mass_tot.push_back(std::pow(10.0, log_mass(generator)));
+        columns.stellar_frac.push_back(fraction(generator));
+    }
+    return columns;
+}
+
+void benchmark_catalog()
+{
+    const std::size_t n = 1000000;
+    GalaxyColumns source = make_galaxies(n);
+
+    std::vector<std::string> result_headers{"Storage", "Build allocations", "Build (ms)", "Stellar mass (ms)"};
+    std::vector<std::vector<std::string>> results;
+    double build = 0, mass = 0, total = 0;
+    std::size_t allocations = 0;
+
+    std::vector<Galaxy> galaxies;
+    allocations = count_allocations([&] {
+        build = time_ms([&] {
+            galaxies.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                galaxies.emplace_back(source.names[i], source.types[i], source.redshift[i], source.mass_tot[i],
+                                      source.stellar_frac[i]);
+            }
+        });
+    });
+    std::vector<double> stellar_mass(n);
+    mass = time_ms([&] {
+        for (std::size_t i = 0; i < n; ++i) {
+            stellar_mass[i] = galaxies[i].get_stellar_mass();
+        }
+    });
+    results.push_back({"vector<Galaxy>", to_string_format(allocations), to_string_format(build),
+                       to_string_format(mass)});
+
+    GalaxyCatalog catalog;
+    allocations = count_allocations([&] {
+        build = time_ms([&] {
+            catalog.append_columns(source.names, source.types, source.redshift, source.mass_tot,
+                                   source.stellar_frac);
+        });
+    });
+    mass = time_ms([&] { catalog.get_stellar_mass(stellar_mass); });
+    for (std::size_t i = 0; i < n; ++i) {
+        total += stellar_mass[i];
+    }
+    results.push_back({"GalaxyCatalog", to_string_format(allocations), to_string_format(build),
+                       to_string_format(mass)});
+
+    std::cout << "\nStoring " << n << " galaxies (total stellar mass " << total << "):" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_hubble_types()
+{
+    const std::size_t n = 1000000;
+    GalaxyColumns source = make_galaxies(n);
+    const std::vector<std::string> names(hubble_type_names.begin(), hubble_type_names.end());
+
+    std::vector<std::string> result_headers{"Validation", "Time (ms)", "Valid"};
+    std::vector<std::vector<std::string>> results;
+    std::size_t valid = 0;
+
+    // The former validation: a scan of the names with string comparisons.
+    double t = time_ms([&] {
+        for (auto it = source.types.begin(); it != source.types.end(); ++it) {
+            valid += std::find(names.begin(), names.end(), *it) != names.end();
+        }
+    });
+    results.push_back({"linear scan", to_string_format(t), to_string_format(valid)});
+
+    valid = 0;
+    t = time_ms([&] {
+        for (auto it = source.types.begin(); it != source.types.end(); ++it) {
+            valid += is_valid_hubble_type(*it);
+        }
+    });
+    results.push_back({"parse_hubble_type", to_string_format(t), to_string_format(valid)});
+
+    std::cout << "\nValidating " << n << " Hubble types (sizeof(Galaxy) = " << sizeof(Galaxy) << "):" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_loader()
+{
+    const std::size_t n = 1000000;
+    GalaxyColumns source = make_galaxies(n);
+    const std::string filename = "benchmark_catalog.csv";
+    {
+        std::ofstream file(filename);
+        file << "name,type,redshift,mass_tot,stellar_frac\n";
+        for (std::size_t i = 0; i < n; ++i) {
+            // One row in a thousand is out of range, to exercise the report.
+            double redshift = i % 1000 == 999 ? 12.0 : source.redshift[i];
+            file << source.names[i] << ',' << source.types[i] << ',' << redshift << ','
+                 << source.mass_tot[i] << ',' << source.stellar_frac[i] << '\n';
+        }
+    }
+
+    std::vector<std::string> result_headers{"Loader", "Time (ms)", "Loaded", "Rejected"};
+    std::vector<std::vector<std::string>> results;
+
+    // Line by line with streams, the way Galaxy(std::istream&) reads.
+    std::size_t loaded = 0, rejected = 0;
+    double t = time_ms([&] {
+        GalaxyCatalog catalog;
+        std::ifstream file(filename);
+        std::string line, name, type, field;
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            double values[3];
+            std::getline(fields, name, ',');
+            std::getline(fields, type, ',');
+            for (std::size_t i = 0; i < 3; ++i) {
+                std::getline(fields, field, ',');
+                values[i] = std::stod(field);
+            }
+            try {
+                catalog.append(name, type, values[0], values[1], values[2]);
+            } catch (const std::invalid_argument&) {
+                ++rejected;
+            }
+        }
+        loaded = catalog.size();
+    });
+    results.push_back({"getline + stod", to_string_format(t), to_string_format(loaded), to_string_format(rejected)});
+
+    const unsigned thread_counts[] = {1, 0};
+    for (std::size_t k = 0; k < 2; ++k) {
+        CatalogLoadReport report;
+        t = time_ms([&] {
+            GalaxyCatalog catalog;
+            report = CatalogLoader(CatalogFormat::csv, true, thread_counts[k]).load(filename, catalog);
+        });
+        std::string threads = thread_counts[k] == 0 ? std::to_string(default_thread_count()) : "1";
+        results.push_back({"CatalogLoader, " + threads + " thread(s)", to_string_format(t),
+                           to_string_format(report.loaded), to_string_format(report.rejected_count)});
+    }
+    std::remove(filename.c_str());
+
+    std::cout << "\nLoading a CSV catalog of " << n << " galaxies:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_index()
+{
+    const std::size_t n = 1000000, n_queries = 1000;
+    GalaxyColumns source = make_galaxies(n);
+    GalaxyCatalog catalog;
+    catalog.append_columns(source.names, source.types, source.redshift, source.mass_tot, source.stellar_frac);
+
+    // Redshift windows of width 0.2 and a lower mass limit, like "0.5 < z < 0.7 and mass > 1e11".
+    std::mt19937_64 generator{2};
+    std::uniform_real_distribution<double> redshift{0.0, 9.8};
+    std::uniform_real_distribution<double> log_mass{6.0, 13.0};
+    std::vector<ValueRange> redshift_ranges, mass_ranges;
+    for (std::size_t q = 0; q < n_queries; ++q) {
+        double z = redshift(generator);
+        redshift_ranges.push_back(ValueRange{z, z + 0.2});
+        mass_ranges.push_back(ValueRange{std::pow(10.0, log_mass(generator)), 1e13});
+    }
+
+    std::vector<std::string> result_headers{"Query", "Time (ms)", "Galaxies found"};
+    std::vector<std::vector<std::string>> results;
+    std::vector<RowId> out;
+    std::size_t found = 0;
+
+    double t = time_ms([&] {
+        std::span<const double> z = catalog.get_redshift();
+        std::span<const double> m = catalog.get_mass_tot();
+        for (std::size_t q = 0; q < n_queries; ++q) {
+            out.clear();
+            for (std::size_t i = 0; i < n; ++i) {
+                if (redshift_ranges[q].contains(z[i]) && mass_ranges[q].contains(m[i])) out.push_back(i);
+            }
+            found += out.size();
+        }
+    });
+    results.push_back({"full column scan", to_string_format(t), to_string_format(found)});
+
+    CatalogIndex* index = nullptr;
+    t = time_ms([&] { index = new CatalogIndex(catalog); });
+    results.push_back({"index construction", to_string_format(t), ""});
+
+    found = 0;
+    t = time_ms([&] {
+        for (std::size_t q = 0; q < n_queries; ++q) {
+            found += index->query(redshift_ranges[q], mass_ranges[q], out).size();
+        }
+    });
+    results.push_back({"k-d tree", to_string_format(t), to_string_format(found)});
+
+    found = 0;
+    t = time_ms([&] {
+        for (std::size_t q = 0; q < n_queries; ++q) {
+            found += index->redshift_range(redshift_ranges[q]).size();
+        }
+    });
+    results.push_back({"sorted redshift only", to_string_format(t), to_string_format(found)});
+    delete index;
+
+    std::cout << "\n" << n_queries << " range queries over " << n << " galaxies:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_hierarchy()
+{
+    const std::size_t n = 1000000, n_hosts = 10000;
+    GalaxyColumns source = make_galaxies(n);
+    GalaxyCatalog catalog;
+    catalog.append_columns(source.names, source.types, source.redshift, source.mass_tot, source.stellar_frac);
+
+    // Galaxies n_hosts and above are satellites of a random earlier galaxy, so hosts have
+    // satellites of satellites and the trees are scattered through the catalog.
+    std::mt19937_64 generator{3};
+    std::vector<RowId> parents(n, no_galaxy);
+    for (std::size_t i = n_hosts; i < n; ++i) {
+        parents[i] = std::uniform_int_distribution<RowId>{0, static_cast<RowId>(i - 1)}(generator);
+    }
+
+    std::vector<std::string> result_headers{"Operation", "Time (ms)", "Total stellar mass of hosts"};
+    std::vector<std::vector<std::string>> results;
+
+    GalaxyHierarchy hierarchy(catalog);
+    double t = time_ms([&] {
+        for (std::size_t i = n_hosts; i < n; ++i) {
+            hierarchy.set_parent(i, parents[i]);
+        }
+    });
+    results.push_back({"set_parent, one by one", to_string_format(t), ""});
+
+    // Move the direct satellites of the first thousand hosts to the last host in one call.
+    std::vector<RowId> moved;
+    for (RowId host = 0; host < 1000; ++host) {
+        for (RowId c = hierarchy.get_first_child(host); c != no_galaxy; c = hierarchy.get_next_sibling(c)) {
+            moved.push_back(c);
+        }
+    }
+    t = time_ms([&] { hierarchy.reparent(moved, n_hosts - 1); });
+    results.push_back({"reparent " + std::to_string(moved.size()) + " satellites", to_string_format(t), ""});
+
+    // Pointer chasing through the links, the way a tree of Galaxy* would be walked.
+    double total = 0;
+    t = time_ms([&] {
+        std::span<const double> mass = catalog.get_mass_tot();
+        std::span<const double> fraction = catalog.get_stellar_frac();
+        std::vector<RowId> stack;
+        for (RowId host = 0; host < n_hosts; ++host) {
+            stack.push_back(host);
+            while (!stack.empty()) {
+                RowId g = stack.back();
+                stack.pop_back();
+                total += mass[g] * fraction[g];
+                for (RowId c = hierarchy.get_first_child(g); c != no_galaxy; c = hierarchy.get_next_sibling(c)) {
+                    stack.push_back(c);
+                }
+            }
+        }
+    });
+    results.push_back({"linked traversal", to_string_format(t), to_string_format(total)});
+
+    t = time_ms([&] { hierarchy.subtree(0); });
+    results.push_back({"preorder layout", to_string_format(t), ""});
+
+    total = 0;
+    t = time_ms([&] {
+        for (RowId host = 0; host < n_hosts; ++host) {
+            total += hierarchy.subtree_totals(host).stellar_mass;
+        }
+    });
+    results.push_back({"subtree_totals per host", to_string_format(t), to_string_format(total)});
+
+    const unsigned thread_counts[] = {1, 0};
+    for (std::size_t k = 0; k < 2; ++k) {
+        std::vector<SubtreeTotals> totals;
+        t = time_ms([&] { totals = hierarchy.all_subtree_totals(thread_counts[k]); });
+        total = 0;
+        for (RowId host = 0; host < n_hosts; ++host) {
+            total += totals[host].stellar_mass;
+        }
+        std::string threads = thread_counts[k] == 0 ? std::to_string(default_thread_count()) : "1";
+        results.push_back({"all_subtree_totals, " + threads + " thread(s)", to_string_format(t),
+                           to_string_format(total)});
+    }
+
+    std::cout << "\nHierarchy of " << n << " galaxies under " << n_hosts << " hosts:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_histogram()
+{
+    const std::size_t n = 1000000;
+    GalaxyColumns source = make_galaxies(n);
+    GalaxyCatalog catalog;
+    catalog.append_columns(source.names, source.types, source.redshift, source.mass_tot, source.stellar_frac);
+    std::vector<Galaxy> galaxies;
+    galaxies.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        galaxies.emplace_back(source.names[i], source.types[i], source.redshift[i], source.mass_tot[i],
+                              source.stellar_frac[i]);
+    }
+
+    // Stellar mass function in bins of 0.25 dex, in 10 redshift bins.
+    const HistogramAxis mass_axis(1e4, 1e13, 36, AxisScale::log10);
+    const HistogramAxis redshift_axis(0, 10, 10);
+
+    std::vector<std::string> result_headers{"Binning", "Time (ms)", "Galaxies binned", "Same as 1 thread"};
+    std::vector<std::vector<std::string>> results;
+
+    // By hand over Galaxy objects.
+    std::vector<std::uint64_t> counts(mass_axis.bins * redshift_axis.bins, 0);
+    double t = time_ms([&] {
+        for (auto it = galaxies.begin(); it != galaxies.end(); ++it) {
+            double x = (std::log10(it->get_stellar_mass()) - 4.0) * 4.0;
+            double y = it->get_redshift();
+            if (x >= 0 && x < 36 && y >= 0 && y < 10) {
+                ++counts[static_cast<std::size_t>(x) + static_cast<std::size_t>(y) * 36];
+            }
+        }
+    });
+    std::uint64_t binned = 0;
+    for (auto it = counts.begin(); it != counts.end(); ++it) {
+        binned += *it;
+    }
+    results.push_back({"loop over Galaxy", to_string_format(t), to_string_format(binned), ""});
+
+    // Weighted by the total mass, to compare the rounding of the sums between thread counts.
+    Histogram reference = stellar_mass_function(catalog, mass_axis, redshift_axis, catalog.get_mass_tot(), 1);
+    const unsigned thread_counts[] = {1, 0};
+    for (std::size_t k = 0; k < 2; ++k) {
+        Histogram histogram(mass_axis);
+        t = time_ms([&] {
+            histogram = stellar_mass_function(catalog, mass_axis, redshift_axis, catalog.get_mass_tot(),
+                                              thread_counts[k]);
+        });
+        std::span<const double> a = histogram.get_weights(), b = reference.get_weights();
+        bool same = std::equal(a.begin(), a.end(), b.begin(), b.end());
+        std::string threads = thread_counts[k] == 0 ? std::to_string(default_thread_count()) : "1";
+        results.push_back({"stellar_mass_function, " + threads + " thread(s)", to_string_format(t),
+                           to_string_format(histogram.total_count()), same ? "yes" : "no"});
+    }
+
+    std::cout << "\nStellar mass function of " << n << " galaxies, " << mass_axis.bins << " x "
+              << redshift_axis.bins << " bins:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_file()
+{
+    const std::size_t n = 1000000;
+    GalaxyColumns source = make_galaxies(n);
+    GalaxyCatalog catalog;
+    catalog.append_columns(source.names, source.types, source.redshift, source.mass_tot, source.stellar_frac);
+    GalaxyHierarchy hierarchy(catalog);
+    for (std::size_t i = 1; i < n; i += 2) {
+        hierarchy.set_parent(i, i - 1);
+    }
+    const std::string text_filename = "benchmark_catalog.csv", binary_filename = "benchmark_catalog.gcat";
+    {
+        std::ofstream file(text_filename);
+        file << "name,type,redshift,mass_tot,stellar_frac\n";
+        for (std::size_t i = 0; i < n; ++i) {
+            file << source.names[i] << ',' << source.types[i] << ',' << source.redshift[i] << ','
+                 << source.mass_tot[i] << ',' << source.stellar_frac[i] << '\n';
+        }
+    }
+
+    std::vector<std::string> result_headers{"Operation", "Time (ms)", "Galaxies"};
+    std::vector<std::vector<std::string>> results;
+
+    double t = time_ms([&] { write_catalog_file(binary_filename, catalog, &hierarchy); });
+    results.push_back({"write_catalog_file", to_string_format(t), to_string_format(catalog.size())});
+
+    std::size_t loaded = 0;
+    t = time_ms([&] {
+        GalaxyCatalog text_catalog;
+        loaded = CatalogLoader().load(text_filename, text_catalog).loaded;
+    });
+    results.push_back({"CatalogLoader, CSV", to_string_format(t), to_string_format(loaded)});
+
+    CatalogFile* file = nullptr;
+    t = time_ms([&] { file = new CatalogFile(binary_filename); });
+    results.push_back({"open CatalogFile", to_string_format(t), to_string_format(file->size())});
+
+    double total = 0;
+    t = time_ms([&] {
+        std::span<const double> mass = file->get_mass_tot();
+        for (std::size_t i = 0; i < mass.size(); ++i) {
+            total += mass[i];
+        }
+    });
+    results.push_back({"first pass over mass_tot", to_string_format(t), to_string_format(file->size())});
+
+    t = time_ms([&] { file->validate(); });
+    results.push_back({"validate", to_string_format(t), to_string_format(file->size())});
+
+    t = time_ms([&] {
+        GalaxyCatalog copy = file->to_catalog();
+        GalaxyHierarchy copy_hierarchy(copy);
+        copy_hierarchy.set_parents(file->get_parents());
+        loaded = copy.size();
+    });
+    results.push_back({"to_catalog + set_parents", to_string_format(t), to_string_format(loaded)});
+    delete file;
+    std::remove(text_filename.c_str());
+    std::remove(binary_filename.c_str());
+
+    std::cout << "\nReading a catalog of " << n << " galaxies (total mass " << total << "):" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = argc > 1 ? argv[1] : "all";
+
+    if (name == "all" || name == "catalog") benchmark_catalog();
+    if (name == "all" || name == "types") benchmark_hubble_types();
+    if (name == "all" || name == "loader") benchmark_loader();
+    if (name == "all" || name == "index") benchmark_index();
+    if (name == "all" || name == "hierarchy") benchmark_hierarchy();
+    if (name == "all" || name == "histogram") benchmark_histogram();
+    if (name == "all" || name == "file") benchmark_file();
+    return 0;
+}
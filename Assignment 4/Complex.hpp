@@ -15,6 +15,9 @@ Author: Zhiyu Liu, University of Manchester, 2023.3.10
 #include <cmath>
 #include <sstream>
 #include <cstdlib>
+#include <charconv>
+#include <system_error>
+#include <stdexcept>
 #include "Table.hpp"
 
 /*
@@ -44,7 +47,8 @@ Methods:
 - operator+, operator-, operator*, operator/
     Overloaded operators follow the rules of complex number arithmetic.
 - str()
-    Convert the complex object to a string
+    Convert the complex object to a string. Uses format_complex() instead of a stringstream,
+    the output is the same as operator<< with the default stream settings.
 - display_info()
     Display the information of the object using Table.hpp
 */
@@ -62,7 +66,7 @@ public:
 
     Complex() = default;
     Complex(double real_in, double imaginary_in) : real{real_in}, imaginary{imaginary_in} {};
-    ~Complex() {}
+    ~Complex() = default;   // Keeps Complex trivially copyable (see ComplexIO.hpp)
 
     double get_real() const { return real; }
     double get_imaginary() const { return imaginary; }
@@ -107,11 +111,71 @@ Complex Complex::operator/(const Complex& c) const
                    (c.real * imaginary - real * c.imaginary) / denominator};
 }
 
+// Precision value that selects the shortest representation which reads back to the same double.
+const int shortest_round_trip = -1;
+
+// Largest useful precision: 17 digits tell any two doubles apart. A double then takes at most
+// 24 characters (sign, digits, point and "e-308"), as in shortest mode.
+const int max_format_precision = 17;
+
+// Throw std::invalid_argument unless precision is shortest_round_trip or 0 to max_format_precision.
+void check_format_precision(int precision)
+{
+    if (precision != shortest_round_trip && (precision < 0 || precision > max_format_precision)) {
+        throw std::invalid_argument("Precision must be shortest_round_trip or 0 to " +
+                                    std::to_string(max_format_precision));
+    }
+}
+
+// Write a double with std::to_chars. precision 6 gives the same digits as the default ostream format.
+std::to_chars_result format_double(char* first, char* last, double value, int precision = 6)
+{
+    if (precision == shortest_round_trip)
+        return std::to_chars(first, last, value);
+    return std::to_chars(first, last, value, std::chars_format::general, precision);
+}
+
+/*
+Write c as "a+bi" or "a-bi" into [first, last) without allocating.
+On success ptr points one past the last character written. If the buffer is too small
+ec is std::errc::value_too_large and the buffer content is unspecified.
+*/
+std::to_chars_result format_complex(char* first, char* last, const Complex& c, int precision = 6)
+{
+    std::to_chars_result result = format_double(first, last, c.get_real(), precision);
+    if (result.ec != std::errc{}) return result;
+
+    if (c.get_imaginary() >= 0) {
+        if (result.ptr == last) return {last, std::errc::value_too_large};
+        *result.ptr++ = '+';
+    }
+    result = format_double(result.ptr, last, c.get_imaginary(), precision);
+    if (result.ec != std::errc{}) return result;
+
+    if (result.ptr == last) return {last, std::errc::value_too_large};
+    *result.ptr++ = 'i';
+    return result;
+}
+
+/*
+Convert a double to a string with format_double, a faster replacement for to_string_format.
+Throws std::invalid_argument for a precision rejected by check_format_precision().
+*/
+std::string to_string_fast(double value, int precision = 6)
+{
+    check_format_precision(precision);
+    char buffer[32];
+    std::to_chars_result result = format_double(buffer, buffer + sizeof(buffer), value, precision);
+    if (result.ec != std::errc{}) throw std::runtime_error("Could not format a double");
+    return std::string(buffer, result.ptr);
+}
+
 std::string Complex::str() const
 {
-    std::ostringstream oss;
-    oss << real << (imaginary >= 0 ? "+" : "") << imaginary << "i";
-    return oss.str();
+    // Two doubles (at most 24 characters each in shortest mode), a sign and 'i'.
+    char buffer[64];
+    std::to_chars_result result = format_complex(buffer, buffer + sizeof(buffer), *this);
+    return std::string(buffer, result.ptr);
 }
 
 std::ostream& operator<<(std::ostream& os, const Complex& c)
@@ -222,10 +286,10 @@ void Complex::display_info() const
 {
     std::vector<std::string> header{"Number", "Real", "Imaginary", "Modulus", "Argument", "Conjugate"};
     std::vector<std::vector<std::string>> rows;
-    std::vector<std::string> row {this->str(), to_string_format(real),
-                                               to_string_format(imaginary),
-                                               to_string_format(this->get_modulus()),
-                                               to_string_format(this->get_argument()),
+    std::vector<std::string> row {this->str(), to_string_fast(real),
+                                               to_string_fast(imaginary),
+                                               to_string_fast(this->get_modulus()),
+                                               to_string_fast(this->get_argument()),
                                                this->get_conjugate().str()};
                                             
     rows.push_back(row);
@@ -0,0 +1,168 @@
+/*
+This file defines batch division routines for arrays of Complex numbers.
+Dividing many numerators by the same denominator only needs the denominator's
+modulus squared (or its reciprocal) once, so the per-element work becomes a
+few multiplications instead of recomputing |d|^2 and dividing twice.
+
+Measured with benchmark.cpp (g++ -O2, best of several runs), the exact scalar
+path gives no gain over operator/ in a loop: the compiler already hoists |d|^2
+out of the inlined operator/ when the denominator does not change. Only the
+fast path is quicker, by 5-40% depending on the run. The fast array path is
+slower than the exact one, see divide() below.
+*/
+
+#ifndef COMPLEX_BATCH_HPP
+#define COMPLEX_BATCH_HPP
+
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include "Complex.hpp"
+
+/*
+Enum name: DivisionMode
+--------------------
+- exact: every quotient is rounded exactly like Complex::operator/.
+         Only |d|^2 is shared, the two divisions per element remain.
+- fast:  the reciprocal 1/d is computed once and each division becomes a
+         complex multiplication. Results may differ from operator/ in the last bit.
+*/
+enum class DivisionMode { exact, fast };
+
+// Return 1/c. The modulus squared is computed once and the division is done once.
+Complex reciprocal(const Complex& c)
+{
+    double re = c.get_real();
+    double im = c.get_imaginary();
+    double inverse_denominator = 1.0 / (re * re + im * im);
+    return Complex{re * inverse_denominator, -im * inverse_denominator};
+}
+
+/*
+Class name: ComplexDivisor
+--------------------
+Description: A denominator prepared for repeated division.
+The modulus squared and the reciprocal are computed once in the constructor,
+divide() then chooses between the exact and the fast path.
+----------------------------------------
+Methods:
+- ComplexDivisor(const Complex& denominator_in)
+    Precompute |d|^2 and 1/d.
+- divide<Mode>(const Complex& numerator) const
+    Compile-time choice of the division mode.
+- divide(const Complex& numerator, DivisionMode mode) const
+    Runtime choice of the division mode.
+*/
+class ComplexDivisor
+{
+private:
+    double real;
+    double imaginary;
+    double denominator;
+    double reciprocal_real;
+    double reciprocal_imaginary;
+
+public:
+    ComplexDivisor(const Complex& denominator_in) :
+        real{denominator_in.get_real()}, imaginary{denominator_in.get_imaginary()}
+    {
+        denominator = real * real + imaginary * imaginary;
+        reciprocal_real = real / denominator;
+        reciprocal_imaginary = -imaginary / denominator;
+    }
+    ~ComplexDivisor() {}
+
+    template <DivisionMode Mode = DivisionMode::exact>
+    Complex divide(const Complex& numerator) const
+    {
+        double a = numerator.get_real();
+        double b = numerator.get_imaginary();
+        if constexpr (Mode == DivisionMode::exact) {
+            return Complex{(a * real + b * imaginary) / denominator,
+                           (real * b - a * imaginary) / denominator};
+        } else {
+            return Complex{a * reciprocal_real - b * reciprocal_imaginary,
+                           a * reciprocal_imaginary + b * reciprocal_real};
+        }
+    }
+
+    Complex divide(const Complex& numerator, DivisionMode mode) const
+    {
+        return mode == DivisionMode::fast ? divide<DivisionMode::fast>(numerator)
+                                          : divide<DivisionMode::exact>(numerator);
+    }
+};
+
+// Array / scalar. Divide n numerators by one denominator and write the quotients to out.
+template <DivisionMode Mode = DivisionMode::exact>
+void divide(const Complex* numerators, std::size_t n, const Complex& denominator, Complex* out)
+{
+    const ComplexDivisor divisor{denominator};
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = divisor.divide<Mode>(numerators[i]);
+    }
+}
+
+/*
+Array / array. Divide numerators[i] by denominators[i].
+The fast path computes one reciprocal of |d_i|^2 per element and multiplies.
+This does not pay off: the compiler packs the two divisions of the exact path
+into one vector division, so the reciprocal only adds the multiplications.
+*/
+template <DivisionMode Mode = DivisionMode::exact>
+void divide(const Complex* numerators, const Complex* denominators, std::size_t n, Complex* out)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double a = numerators[i].get_real();
+        double b = numerators[i].get_imaginary();
+        double c = denominators[i].get_real();
+        double d = denominators[i].get_imaginary();
+        double denominator = c * c + d * d;
+        if constexpr (Mode == DivisionMode::exact) {
+            out[i] = Complex{(a * c + b * d) / denominator, (c * b - a * d) / denominator};
+        } else {
+            double inverse_denominator = 1.0 / denominator;
+            out[i] = Complex{(a * c + b * d) * inverse_denominator,
+                             (c * b - a * d) * inverse_denominator};
+        }
+    }
+}
+
+// Runtime-mode wrappers for vectors.
+std::vector<Complex> divide(const std::vector<Complex>& numerators, const Complex& denominator,
+                            DivisionMode mode = DivisionMode::exact)
+{
+    std::vector<Complex> quotients(numerators.size());
+    if (mode == DivisionMode::fast)
+        divide<DivisionMode::fast>(numerators.data(), numerators.size(), denominator, quotients.data());
+    else
+        divide<DivisionMode::exact>(numerators.data(), numerators.size(), denominator, quotients.data());
+    return quotients;
+}
+
+std::vector<Complex> divide(const std::vector<Complex>& numerators, const std::vector<Complex>& denominators,
+                            DivisionMode mode = DivisionMode::exact)
+{
+    if (numerators.size() != denominators.size()) {
+        throw std::invalid_argument("Numerator and denominator arrays must have the same length");
+    }
+
+    std::vector<Complex> quotients(numerators.size());
+    if (mode == DivisionMode::fast)
+        divide<DivisionMode::fast>(numerators.data(), denominators.data(), numerators.size(), quotients.data());
+    else
+        divide<DivisionMode::exact>(numerators.data(), denominators.data(), numerators.size(), quotients.data());
+    return quotients;
+}
+
+// Normalize a vector in place, eg: divide every sample by the same gain.
+void divide_in_place(std::vector<Complex>& numerators, const Complex& denominator,
+                     DivisionMode mode = DivisionMode::exact)
+{
+    if (mode == DivisionMode::fast)
+        divide<DivisionMode::fast>(numerators.data(), numerators.size(), denominator, numerators.data());
+    else
+        divide<DivisionMode::exact>(numerators.data(), numerators.size(), denominator, numerators.data());
+}
+
+#endif
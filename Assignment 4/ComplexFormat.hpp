@@ -0,0 +1,98 @@
+/*
+This file defines the ComplexWriter class, a buffered text writer for large
+numbers of Complex values. Values are formatted with format_complex() straight
+into one large buffer, which is handed to the output stream in big chunks.
+*/
+
+#ifndef COMPLEX_FORMAT_HPP
+#define COMPLEX_FORMAT_HPP
+
+#include <iostream>
+#include <vector>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "Complex.hpp"
+
+/*
+Class name: ComplexWriter
+--------------------
+Description: Writes Complex numbers as text ("a+bi") followed by a separator.
+Nothing reaches the stream until the buffer is full, flush() is called or the writer is destroyed.
+----------------------------------------
+Attributes:
+- os: (std::ostream&) destination stream.
+- buffer: (vector of char) formatting buffer, used is the number of bytes filled.
+- precision: significant digits per double, or shortest_round_trip.
+----------------------------------------
+Methods:
+- ComplexWriter(std::ostream& os_in, int precision_in, std::size_t buffer_size)
+    Parameterized constructor. The default buffer is 1 MiB. precision_in is shortest_round_trip
+    or 0 to 17 digits, the most that tell two doubles apart; anything else throws std::invalid_argument.
+- ~ComplexWriter()
+    Destructor. Flushes the remaining buffer.
+- write(const Complex& c, char separator)
+    Append one number.
+- write(const Complex* data, std::size_t n, char separator), write(const std::vector<Complex>&, char)
+    Append an array of numbers.
+- flush()
+    Hand the buffered bytes to the stream (the stream itself is not flushed).
+*/
+class ComplexWriter
+{
+private:
+    std::ostream& os;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    int precision;
+
+    // Longest text of a single value: two doubles of at most 24 characters (see
+    // max_format_precision), a sign, 'i' and the separator.
+    static constexpr std::size_t max_value_length = 64;
+
+public:
+    ComplexWriter(std::ostream& os_in, int precision_in = 6, std::size_t buffer_size = 1 << 20);
+    ~ComplexWriter() { flush(); }
+
+    void write(const Complex& c, char separator = '\n');
+    void write(const Complex* data, std::size_t n, char separator = '\n');
+    void write(const std::vector<Complex>& data, char separator = '\n') { write(data.data(), data.size(), separator); }
+    void flush();
+};
+
+ComplexWriter::ComplexWriter(std::ostream& os_in, int precision_in, std::size_t buffer_size) :
+    os(os_in), buffer(std::max(buffer_size, max_value_length)), precision(precision_in)
+{
+    check_format_precision(precision);
+}
+
+void ComplexWriter::write(const Complex& c, char separator)
+{
+    if (buffer.size() - used < max_value_length) flush();
+
+    char* first = buffer.data() + used;
+    std::to_chars_result result = format_complex(first, buffer.data() + buffer.size(), c, precision);
+    if (result.ec != std::errc{} || result.ptr == buffer.data() + buffer.size()) {
+        throw std::runtime_error("Complex number too long for the ComplexWriter buffer");
+    }
+    *result.ptr++ = separator;
+    used = result.ptr - buffer.data();
+}
+
+void ComplexWriter::write(const Complex* data, std::size_t n, char separator)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        write(data[i], separator);
+    }
+}
+
+void ComplexWriter::flush()
+{
+    if (used > 0) {
+        os.write(buffer.data(), used);
+        used = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,349 @@
+/*
+This file defines a binary file format for arrays of Complex numbers,
+a streaming writer and a memory-mapped reader.
+------------------------------------------------------------
+File layout:
++--------------------------------------------------------------------+
+| header (32 bytes)                                                  |
+|   magic "CPXA" | version (u16) | layout (u8) | byte order (u8)     |
+|   count (u64) | chunk size (u64) | reserved (u64)                  |
++--------------------------------------------------------------------+
+| interleaved: re0 im0 re1 im1 ...                                   |
+| split:       re[0, k) im[0, k) re[k, 2k) im[k, 2k) ...  (k = chunk) |
++--------------------------------------------------------------------+
+All values are raw doubles in the byte order recorded in the header.
+The split layout groups similar values together, which compresses much better.
+A split file with a single chunk (chunk size = count) is the plain split layout.
+*/
+
+#ifndef COMPLEX_IO_HPP
+#define COMPLEX_IO_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <span>
+#include <bit>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include "Complex.hpp"
+#include "MappedFile.hpp"
+
+// A Complex must be exactly two doubles so interleaved data can be viewed in place.
+static_assert(sizeof(Complex) == 2 * sizeof(double), "Complex must be two packed doubles");
+static_assert(std::is_trivially_copyable_v<Complex>, "Complex must be trivially copyable");
+
+enum class ComplexLayout : std::uint8_t { interleaved = 0, split = 1 };
+
+struct ComplexArrayHeader
+{
+    char magic[4] = {'C', 'P', 'X', 'A'};
+    std::uint16_t version = 1;
+    ComplexLayout layout = ComplexLayout::interleaved;
+    std::uint8_t byte_order = std::endian::native == std::endian::little ? 1 : 2;
+    std::uint64_t count = 0;
+    std::uint64_t chunk_size = 0;
+    std::uint64_t reserved = 0;
+};
+static_assert(sizeof(ComplexArrayHeader) == 32, "Unexpected header padding");
+
+// Reverse the bytes of a double, used when reading a file written on a machine of the other byte order.
+double byteswap_double(double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits = __builtin_bswap64(bits);
+    std::memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+
+/*
+Class name: ComplexArrayWriter
+--------------------
+Description: Streams Complex values into a binary file.
+Values are collected into a buffer of chunk_size values; full buffers are written
+in one call. close() writes the final partial chunk and patches the count in the header.
+----------------------------------------
+Methods:
+- ComplexArrayWriter(const std::string& filename, ComplexLayout layout_in, std::size_t chunk_size_in)
+    Create the file. Throws std::runtime_error if it cannot be opened.
+- ~ComplexArrayWriter()
+    Destructor. Closes the file if close() was not called, but cannot report a failure:
+    call close() to know that the file is complete.
+- write(const Complex& c), write(const Complex* data, std::size_t n)
+    Append values.
+- close()
+    Finish the file. Further writes are ignored. Throws std::runtime_error if any write failed,
+    for example on a full disk.
+*/
+class ComplexArrayWriter
+{
+private:
+    std::string filename;
+    std::ofstream file;
+    ComplexArrayHeader header;
+    std::vector<double> real_buffer;
+    std::vector<double> imag_buffer;
+    std::size_t buffered = 0;
+    bool open = true;
+
+    void write_chunk();
+
+public:
+    ComplexArrayWriter(const std::string& filename, ComplexLayout layout_in = ComplexLayout::interleaved,
+                       std::size_t chunk_size_in = 65536);
+    ~ComplexArrayWriter();
+    ComplexArrayWriter(const ComplexArrayWriter&) = delete;
+    ComplexArrayWriter& operator=(const ComplexArrayWriter&) = delete;
+
+    void write(const Complex& c);
+    void write(const Complex* data, std::size_t n);
+    void close();
+};
+
+ComplexArrayWriter::ComplexArrayWriter(const std::string& filename_in, ComplexLayout layout_in,
+                                       std::size_t chunk_size_in) :
+    filename(filename_in), file(filename, std::ios::binary | std::ios::trunc)
+{
+    if (!file.good()) {
+        throw std::runtime_error("Could not open " + filename);
+    }
+    header.layout = layout_in;
+    header.chunk_size = std::max<std::size_t>(chunk_size_in, 1);
+    real_buffer.resize(header.chunk_size);
+    imag_buffer.resize(header.layout == ComplexLayout::split ? header.chunk_size : 0);
+
+    // The count is patched by close().
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+ComplexArrayWriter::~ComplexArrayWriter()
+{
+    try {
+        close();
+    } catch (const std::runtime_error&) {
+        // A destructor must not throw; the caller who needs to know calls close().
+    }
+}
+
+void ComplexArrayWriter::write_chunk()
+{
+    if (buffered == 0) return;
+    if (header.layout == ComplexLayout::split) {
+        file.write(reinterpret_cast<const char*>(real_buffer.data()), buffered * sizeof(double));
+        file.write(reinterpret_cast<const char*>(imag_buffer.data()), buffered * sizeof(double));
+        header.count += buffered;
+        buffered = 0;
+    } else {
+        // real_buffer holds interleaved pairs in this layout.
+        file.write(reinterpret_cast<const char*>(real_buffer.data()), buffered * sizeof(double));
+        header.count += buffered / 2;
+        buffered = 0;
+    }
+}
+
+void ComplexArrayWriter::write(const Complex& c)
+{
+    write(&c, 1);
+}
+
+void ComplexArrayWriter::write(const Complex* data, std::size_t n)
+{
+    if (!open) return;
+
+    if (header.layout == ComplexLayout::split) {
+        for (std::size_t i = 0; i < n; ++i) {
+            real_buffer[buffered] = data[i].get_real();
+            imag_buffer[buffered] = data[i].get_imaginary();
+            if (++buffered == header.chunk_size) write_chunk();
+        }
+    } else {
+        // Interleaved data is already in file order: large inputs are written directly.
+        if (n * 2 >= real_buffer.size()) {
+            write_chunk();
+            file.write(reinterpret_cast<const char*>(data), n * sizeof(Complex));
+            header.count += n;
+            return;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            if (buffered + 2 > real_buffer.size()) write_chunk();
+            real_buffer[buffered++] = data[i].get_real();
+            real_buffer[buffered++] = data[i].get_imaginary();
+        }
+    }
+}
+
+void ComplexArrayWriter::close()
+{
+    if (!open) return;
+    write_chunk();
+    if (header.layout == ComplexLayout::interleaved) {
+        // Chunks have no meaning for interleaved data.
+        header.chunk_size = header.count;
+    }
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    open = false;
+    // The stream state is sticky: any failed write, seek or close since the start shows here.
+    if (!file) throw std::runtime_error("Could not write " + filename);
+}
+
+// Write a whole array at once. The split layout is written as a single chunk unless chunk_size is given.
+void write_complex_array(const std::string& filename, const std::vector<Complex>& data,
+                         ComplexLayout layout = ComplexLayout::interleaved, std::size_t chunk_size = 0)
+{
+    ComplexArrayWriter writer{filename, layout, chunk_size == 0 ? data.size() : chunk_size};
+    writer.write(data.data(), data.size());
+    writer.close();
+}
+
+/*
+Class name: MappedComplexArray
+--------------------
+Description: Opens a file written by ComplexArrayWriter with mmap. Nothing is copied:
+values() and real_chunk()/imag_chunk() are spans into the mapping. They require the
+file to have the native byte order; operator[] and to_vector() work for any file.
+----------------------------------------
+Methods:
+- MappedComplexArray(const std::string& filename)
+    Map and validate the file. Throws std::runtime_error for a malformed file.
+- size(), get_layout(), get_chunk_size(), chunk_count(), is_native_byte_order()
+    Getters.
+- values()
+    Interleaved files only: the whole array as std::span<const Complex>.
+- real_chunk(std::size_t k), imag_chunk(std::size_t k)
+    Split files only: the real / imaginary parts of chunk k as std::span<const double>.
+- operator[](std::size_t i)
+    The i-th value for any layout and byte order.
+- to_vector()
+    Copy the whole array into a vector.
+*/
+class MappedComplexArray
+{
+private:
+    MappedFile file;
+    ComplexArrayHeader header;
+    const double* payload = nullptr;
+
+    void require_native() const;
+
+public:
+    MappedComplexArray(const std::string& filename);
+
+    std::size_t size() const { return header.count; }
+    ComplexLayout get_layout() const { return header.layout; }
+    std::size_t get_chunk_size() const { return header.chunk_size; }
+    std::size_t chunk_count() const { return header.count == 0 ? 0 : (header.count - 1) / header.chunk_size + 1; }
+    bool is_native_byte_order() const { return header.byte_order == ComplexArrayHeader{}.byte_order; }
+
+    std::span<const Complex> values() const;
+    std::span<const double> real_chunk(std::size_t k) const;
+    std::span<const double> imag_chunk(std::size_t k) const;
+    Complex operator[](std::size_t i) const;
+    std::vector<Complex> to_vector() const;
+};
+
+MappedComplexArray::MappedComplexArray(const std::string& filename) : file(filename)
+{
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error(filename + " is too short to be a complex array file");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "CPXA", 4) != 0 || header.version != 1) {
+        throw std::runtime_error(filename + " is not a complex array file");
+    }
+    if (header.byte_order != 1 && header.byte_order != 2) {
+        throw std::runtime_error(filename + " has an unknown byte order");
+    }
+    if (header.layout != ComplexLayout::interleaved && header.layout != ComplexLayout::split) {
+        throw std::runtime_error(filename + " has an unknown layout");
+    }
+    if (!is_native_byte_order()) {
+        // The header itself was written in the other byte order.
+        header.version = __builtin_bswap16(header.version);
+        header.count = __builtin_bswap64(header.count);
+        header.chunk_size = __builtin_bswap64(header.chunk_size);
+    }
+    if (header.chunk_size == 0 && header.count > 0) {
+        throw std::runtime_error(filename + " has an invalid chunk size");
+    }
+    // Divided rather than multiplied, so that a corrupted count cannot overflow.
+    if (header.count > (file.size() - sizeof(header)) / sizeof(Complex)) {
+        throw std::runtime_error(filename + " is truncated");
+    }
+    payload = reinterpret_cast<const double*>(file.data() + sizeof(header));
+}
+
+void MappedComplexArray::require_native() const
+{
+    if (!is_native_byte_order()) {
+        throw std::runtime_error("Cannot view a file of the other byte order in place, use to_vector()");
+    }
+}
+
+std::span<const Complex> MappedComplexArray::values() const
+{
+    require_native();
+    if (header.layout != ComplexLayout::interleaved) {
+        throw std::runtime_error("values() needs an interleaved file, use real_chunk()/imag_chunk()");
+    }
+    return {reinterpret_cast<const Complex*>(payload), header.count};
+}
+
+std::span<const double> MappedComplexArray::real_chunk(std::size_t k) const
+{
+    require_native();
+    if (header.layout != ComplexLayout::split || k >= chunk_count()) {
+        throw std::out_of_range("No such real chunk");
+    }
+    std::size_t begin = k * header.chunk_size;
+    std::size_t length = std::min<std::size_t>(header.chunk_size, header.count - begin);
+    return {payload + 2 * begin, length};
+}
+
+std::span<const double> MappedComplexArray::imag_chunk(std::size_t k) const
+{
+    std::span<const double> real = real_chunk(k);
+    return {real.data() + real.size(), real.size()};
+}
+
+Complex MappedComplexArray::operator[](std::size_t i) const
+{
+    double re, im;
+    if (header.layout == ComplexLayout::interleaved) {
+        re = payload[2 * i];
+        im = payload[2 * i + 1];
+    } else {
+        std::size_t k = i / header.chunk_size;
+        std::size_t begin = k * header.chunk_size;
+        std::size_t length = std::min<std::size_t>(header.chunk_size, header.count - begin);
+        re = payload[2 * begin + (i - begin)];
+        im = payload[2 * begin + length + (i - begin)];
+    }
+    if (!is_native_byte_order()) {
+        re = byteswap_double(re);
+        im = byteswap_double(im);
+    }
+    return Complex{re, im};
+}
+
+std::vector<Complex> MappedComplexArray::to_vector() const
+{
+    if (header.layout == ComplexLayout::interleaved && is_native_byte_order()) {
+        std::span<const Complex> all = values();
+        return std::vector<Complex>(all.begin(), all.end());
+    }
+    std::vector<Complex> result(header.count);
+    for (std::size_t i = 0; i < header.count; ++i) {
+        result[i] = (*this)[i];
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,366 @@
+/*
+This file defines convolution and correlation of complex signals.
+Short filters use a direct kernel on split real/imaginary arrays, long filters use
+FFT-based overlap-add. StreamingConvolver filters unbounded input block by block
+(overlap-save) and convolve_channels() processes independent channels in parallel.
+*/
+
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include "Complex.hpp"
+#include "Parallel.hpp"
+
+/*
+Enum name: ConvolutionMethod
+- automatic: direct for short filters, FFT otherwise (see choose_method()).
+- direct:    O(n m) kernel.
+- fft:       overlap-add with FFT blocks, O(n log m).
+*/
+enum class ConvolutionMethod { automatic, direct, fft };
+
+// Filters up to this length are convolved directly.
+const std::size_t direct_filter_length = 64;
+
+// Smallest power of two that is >= n.
+std::size_t next_power_of_two(std::size_t n)
+{
+    std::size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+/*
+Class name: FFTPlan
+--------------------
+Description: Radix-2 in-place FFT of a fixed power-of-two size. The twiddle factors and the
+bit-reversal permutation are computed once in the constructor and reused by every transform.
+----------------------------------------
+Methods:
+- FFTPlan(std::size_t size_in)
+    Throws std::invalid_argument if the size is not a power of two.
+- size()
+    Getter.
+- transform(Complex* data, bool inverse) const
+    Forward (exp(-2 pi i k n / N)) or inverse transform. The inverse is scaled by 1/N.
+*/
+class FFTPlan
+{
+private:
+    std::size_t n;
+    std::vector<Complex> twiddles;
+    std::vector<std::size_t> reversed;
+
+public:
+    FFTPlan(std::size_t size_in);
+
+    std::size_t size() const { return n; }
+    void transform(Complex* data, bool inverse) const;
+};
+
+FFTPlan::FFTPlan(std::size_t size_in) : n(size_in)
+{
+    if (n == 0 || (n & (n - 1)) != 0) {
+        throw std::invalid_argument("FFT size must be a power of two");
+    }
+
+    twiddles.reserve(n / 2);
+    for (std::size_t k = 0; k < n / 2; ++k) {
+        double angle = -2 * M_PI * k / n;
+        twiddles.push_back(Complex{std::cos(angle), std::sin(angle)});
+    }
+
+    reversed.resize(n);
+    std::size_t bits = 0;
+    while ((std::size_t{1} << bits) < n) ++bits;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t r = 0;
+        for (std::size_t b = 0; b < bits; ++b) {
+            if (i & (std::size_t{1} << b)) r |= std::size_t{1} << (bits - 1 - b);
+        }
+        reversed[i] = r;
+    }
+}
+
+void FFTPlan::transform(Complex* data, bool inverse) const
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        if (i < reversed[i]) std::swap(data[i], data[reversed[i]]);
+    }
+
+    for (std::size_t length = 2; length <= n; length <<= 1) {
+        std::size_t half = length / 2;
+        std::size_t step = n / length;
+        for (std::size_t start = 0; start < n; start += length) {
+            for (std::size_t k = 0; k < half; ++k) {
+                Complex w = inverse ? twiddles[k * step].get_conjugate() : twiddles[k * step];
+                Complex even = data[start + k];
+                Complex odd = data[start + k + half] * w;
+                data[start + k] = even + odd;
+                data[start + k + half] = even - odd;
+            }
+        }
+    }
+
+    if (inverse) {
+        Complex scale{1.0 / n, 0};
+        for (std::size_t i = 0; i < n; ++i) {
+            data[i] = data[i] * scale;
+        }
+    }
+}
+
+/*
+Direct convolution out[k] = sum_j x[k - j] * h[j] for n inputs and m taps (out has n + m - 1 entries).
+The output is produced in blocks. For each block the needed input window is copied into small
+separate real/imaginary arrays, so the inner loop is a plain multiply-add over contiguous doubles
+which the compiler vectorizes, and the scratch arrays stay in cache.
+*/
+void convolve_direct(const Complex* x, std::size_t n, const Complex* h, std::size_t m, Complex* out)
+{
+    if (n == 0 || m == 0) return;
+
+    const std::size_t block = 1024;
+    const std::size_t total = n + m - 1;
+    std::vector<double> xr(block + m - 1), xi(block + m - 1), yr(block), yi(block);
+
+    for (std::size_t begin = 0; begin < total; begin += block) {
+        const std::size_t length = std::min(block, total - begin);
+
+        // Input window x[begin - (m - 1), begin + length), zero outside the signal.
+        for (std::size_t w = 0; w < length + m - 1; ++w) {
+            std::size_t i = begin + w;
+            bool inside = i >= m - 1 && i - (m - 1) < n;
+            xr[w] = inside ? x[i - (m - 1)].get_real() : 0.0;
+            xi[w] = inside ? x[i - (m - 1)].get_imaginary() : 0.0;
+        }
+        std::fill(yr.begin(), yr.begin() + length, 0.0);
+        std::fill(yi.begin(), yi.begin() + length, 0.0);
+
+        for (std::size_t j = 0; j < m; ++j) {
+            const double hr = h[j].get_real();
+            const double hi = h[j].get_imaginary();
+            double* __restrict out_r = yr.data();
+            double* __restrict out_i = yi.data();
+            const double* __restrict in_r = xr.data() + (m - 1 - j);
+            const double* __restrict in_i = xi.data() + (m - 1 - j);
+            for (std::size_t k = 0; k < length; ++k) {
+                out_r[k] += in_r[k] * hr - in_i[k] * hi;
+                out_i[k] += in_r[k] * hi + in_i[k] * hr;
+            }
+        }
+
+        for (std::size_t k = 0; k < length; ++k) {
+            out[begin + k] = Complex{yr[k], yi[k]};
+        }
+    }
+}
+
+/*
+Overlap-add: the input is cut into blocks of L samples, each block is zero-padded to the
+FFT size N >= L + m - 1, multiplied by the transformed filter and the results are summed.
+*/
+void convolve_fft(const Complex* x, std::size_t n, const Complex* h, std::size_t m, Complex* out)
+{
+    if (n == 0 || m == 0) return;
+
+    // An FFT of about 4 m samples keeps most of each block useful output.
+    std::size_t fft_size = next_power_of_two(std::max<std::size_t>(4 * m, 64));
+    std::size_t block = fft_size - m + 1;
+    FFTPlan plan{fft_size};
+
+    std::vector<Complex> filter(fft_size, Complex{0, 0});
+    std::copy(h, h + m, filter.begin());
+    plan.transform(filter.data(), false);
+
+    std::fill(out, out + n + m - 1, Complex{0, 0});
+    std::vector<Complex> buffer(fft_size);
+    for (std::size_t start = 0; start < n; start += block) {
+        std::size_t length = std::min(block, n - start);
+        std::fill(buffer.begin(), buffer.end(), Complex{0, 0});
+        std::copy(x + start, x + start + length, buffer.begin());
+
+        plan.transform(buffer.data(), false);
+        for (std::size_t k = 0; k < fft_size; ++k) {
+            buffer[k] = buffer[k] * filter[k];
+        }
+        plan.transform(buffer.data(), true);
+
+        std::size_t produced = std::min(fft_size, n + m - 1 - start);
+        for (std::size_t k = 0; k < produced; ++k) {
+            out[start + k] = out[start + k] + buffer[k];
+        }
+    }
+}
+
+// Direct for short filters or tiny problems, FFT otherwise.
+ConvolutionMethod choose_method(std::size_t n, std::size_t m)
+{
+    if (std::min(n, m) <= direct_filter_length || n * m <= 1 << 16) return ConvolutionMethod::direct;
+    return ConvolutionMethod::fft;
+}
+
+// Full linear convolution of x and h, the result has x.size() + h.size() - 1 samples.
+std::vector<Complex> convolve(const std::vector<Complex>& x, const std::vector<Complex>& h,
+                              ConvolutionMethod method = ConvolutionMethod::automatic)
+{
+    if (x.empty() || h.empty()) return {};
+
+    // Convolution is symmetric, let the shorter signal play the role of the filter.
+    const std::vector<Complex>& signal = x.size() >= h.size() ? x : h;
+    const std::vector<Complex>& filter = x.size() >= h.size() ? h : x;
+    if (method == ConvolutionMethod::automatic) method = choose_method(signal.size(), filter.size());
+
+    std::vector<Complex> out(x.size() + h.size() - 1);
+    if (method == ConvolutionMethod::direct)
+        convolve_direct(signal.data(), signal.size(), filter.data(), filter.size(), out.data());
+    else
+        convolve_fft(signal.data(), signal.size(), filter.data(), filter.size(), out.data());
+    return out;
+}
+
+/*
+Cross-correlation r[k] = sum_n x[n + k - (m - 1)] * conj(h[n]) for k in [0, n + m - 1).
+Entry k is the lag k - (m - 1), so the zero lag is at index h.size() - 1.
+It is computed as the convolution of x with the reversed conjugate of h.
+*/
+std::vector<Complex> correlate(const std::vector<Complex>& x, const std::vector<Complex>& h,
+                               ConvolutionMethod method = ConvolutionMethod::automatic)
+{
+    std::vector<Complex> reversed;
+    reversed.reserve(h.size());
+    for (auto it = h.rbegin(); it != h.rend(); ++it) {
+        reversed.push_back(it->get_conjugate());
+    }
+    return convolve(x, reversed, method);
+}
+
+// Convolve every channel with the same filter, channels are split across threads.
+std::vector<std::vector<Complex>> convolve_channels(const std::vector<std::vector<Complex>>& channels,
+                                                    const std::vector<Complex>& h, unsigned threads = 0,
+                                                    ConvolutionMethod method = ConvolutionMethod::automatic)
+{
+    std::vector<std::vector<Complex>> outputs(channels.size());
+    parallel_for(channels.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t c = begin; c < end; ++c) {
+            outputs[c] = convolve(channels[c], h, method);
+        }
+    });
+    return outputs;
+}
+
+/*
+Class name: StreamingConvolver
+--------------------
+Description: Filters an unbounded stream with a fixed filter h (overlap-save).
+Input is collected into blocks of block_size samples. When a block is complete the
+last m - 1 inputs of the previous blocks are prepended and the valid part of the
+convolution is appended to the output, so output lags input by at most one block.
+Long filters use an FFT of size block_size + m - 1, short ones the direct kernel.
+----------------------------------------
+Methods:
+- StreamingConvolver(const std::vector<Complex>& h, std::size_t block_size_hint)
+    Throws std::invalid_argument for an empty filter.
+- process(const Complex* in, std::size_t n, std::vector<Complex>& out)
+    Feed n samples and append every finished output sample to out.
+- flush(std::vector<Complex>& out)
+    End of stream: emit the remaining samples including the m - 1 tail samples.
+    Afterwards the object starts a new stream.
+*/
+class StreamingConvolver
+{
+private:
+    std::vector<Complex> filter;
+    std::vector<Complex> filter_spectrum;
+    FFTPlan plan;
+    std::size_t block_size;
+    bool use_fft;
+    std::vector<Complex> segment;   // m - 1 history samples followed by the current block
+    std::size_t filled = 0;         // samples of the current block in segment
+
+    void run_block(std::size_t valid, std::vector<Complex>& out);
+
+public:
+    StreamingConvolver(const std::vector<Complex>& h, std::size_t block_size_hint = 4096);
+
+    std::size_t get_block_size() const { return block_size; }
+    void process(const Complex* in, std::size_t n, std::vector<Complex>& out);
+    void process(const std::vector<Complex>& in, std::vector<Complex>& out) { process(in.data(), in.size(), out); }
+    void flush(std::vector<Complex>& out);
+};
+
+StreamingConvolver::StreamingConvolver(const std::vector<Complex>& h, std::size_t block_size_hint) :
+    filter(h),
+    plan(next_power_of_two(std::max<std::size_t>(block_size_hint, 1) + std::max<std::size_t>(h.size(), 1) - 1))
+{
+    if (h.empty()) {
+        throw std::invalid_argument("The filter must have at least one tap");
+    }
+    std::size_t m = filter.size();
+    block_size = plan.size() - (m - 1);
+    use_fft = m > direct_filter_length;
+    segment.assign(plan.size(), Complex{0, 0});
+
+    if (use_fft) {
+        filter_spectrum.assign(plan.size(), Complex{0, 0});
+        std::copy(filter.begin(), filter.end(), filter_spectrum.begin());
+        plan.transform(filter_spectrum.data(), false);
+    }
+}
+
+// Compute the outputs of the first `valid` samples of the current block and shift the history.
+void StreamingConvolver::run_block(std::size_t valid, std::vector<Complex>& out)
+{
+    std::size_t m = filter.size();
+    std::size_t history = m - 1;
+
+    if (use_fft) {
+        std::vector<Complex> buffer(segment);
+        plan.transform(buffer.data(), false);
+        for (std::size_t k = 0; k < buffer.size(); ++k) {
+            buffer[k] = buffer[k] * filter_spectrum[k];
+        }
+        plan.transform(buffer.data(), true);
+        // The first m - 1 outputs are corrupted by the circular wrap, the rest are valid.
+        out.insert(out.end(), buffer.begin() + history, buffer.begin() + history + valid);
+    } else {
+        std::vector<Complex> full(history + valid + m - 1);
+        convolve_direct(segment.data(), history + valid, filter.data(), m, full.data());
+        out.insert(out.end(), full.begin() + history, full.begin() + history + valid);
+    }
+
+    // Keep the last m - 1 inputs as the history of the next block.
+    std::copy(segment.begin() + valid, segment.begin() + valid + history, segment.begin());
+    std::fill(segment.begin() + history, segment.end(), Complex{0, 0});
+    filled = 0;
+}
+
+void StreamingConvolver::process(const Complex* in, std::size_t n, std::vector<Complex>& out)
+{
+    std::size_t history = filter.size() - 1;
+    while (n > 0) {
+        std::size_t take = std::min(n, block_size - filled);
+        std::copy(in, in + take, segment.begin() + history + filled);
+        filled += take;
+        in += take;
+        n -= take;
+        if (filled == block_size) run_block(block_size, out);
+    }
+}
+
+void StreamingConvolver::flush(std::vector<Complex>& out)
+{
+    std::size_t history = filter.size() - 1;
+    // Feeding m - 1 zeros releases the tail of the convolution.
+    std::vector<Complex> zeros(history, Complex{0, 0});
+    process(zeros.data(), zeros.size(), out);
+    if (filled > 0) run_block(filled, out);
+    std::fill(segment.begin(), segment.end(), Complex{0, 0});
+}
+
+#endif
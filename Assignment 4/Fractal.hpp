@@ -0,0 +1,254 @@
+/*
+This file defines the FractalRenderer class, an escape-time renderer for the
+Mandelbrot and Julia sets. It is used as a throughput benchmark for Complex:
+the scalar path iterates z = z * z + c through the Complex operators.
+*/
+
+#ifndef FRACTAL_HPP
+#define FRACTAL_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include "Complex.hpp"
+#include "Parallel.hpp"
+
+/*
+Struct name: FractalConfig
+--------------------
+- width, height: size of the image in pixels.
+- x_min, x_max, y_min, y_max: region of the complex plane mapped onto the image.
+- max_iterations: iteration cap; points that reach it are treated as inside the set.
+- julia: false renders the Mandelbrot set (z0 = 0, c = pixel),
+         true renders the Julia set of julia_c (z0 = pixel, c = julia_c).
+- tile_size: side of the square tiles handed out by the parallel scheduler.
+*/
+struct FractalConfig
+{
+    std::size_t width = 1024;
+    std::size_t height = 768;
+    double x_min = -2.5;
+    double x_max = 1.0;
+    double y_min = -1.3125;
+    double y_max = 1.3125;
+    unsigned max_iterations = 500;
+    bool julia = false;
+    Complex julia_c{-0.8, 0.156};
+    std::size_t tile_size = 32;
+};
+
+/*
+Class name: FractalRenderer
+--------------------
+Description: Computes the escape time of every pixel of a FractalConfig.
+Every render method fills the same iteration buffer and returns the total number
+of iterations performed, so callers can report iterations per second.
+----------------------------------------
+Attributes:
+- config: (FractalConfig) the image to render.
+- iterations: (vector of unsigned) escape time of each pixel, row-major.
+----------------------------------------
+Methods:
+- FractalRenderer(const FractalConfig& config_in)
+    Parameterized constructor. Throws std::invalid_argument for an empty image.
+- render_scalar()
+    One pixel at a time through Complex::operator* and Complex::operator+.
+- render_batch()
+    Pixels of a row are iterated in lanes of batch_size with plain double arrays,
+    so the compiler can vectorize the inner loop.
+- render_parallel(unsigned threads)
+    Tiles are taken from a shared atomic counter, so threads that get cheap tiles
+    (points that escape early) simply take more of them.
+- get_iterations()
+    Getter.
+- write_pgm(const std::string& filename)
+    Write the image as a binary 8-bit PGM file.
+*/
+class FractalRenderer
+{
+private:
+    FractalConfig config;
+    std::vector<unsigned> iterations;
+
+    static constexpr std::size_t batch_size = 8;
+
+    double x_at(std::size_t x) const { return config.x_min + (config.x_max - config.x_min) * x / config.width; }
+    double y_at(std::size_t y) const { return config.y_max - (config.y_max - config.y_min) * y / config.height; }
+    unsigned long long render_span(std::size_t y, std::size_t x_begin, std::size_t x_end);
+
+public:
+    FractalRenderer(const FractalConfig& config_in);
+    ~FractalRenderer() {}
+
+    unsigned long long render_scalar();
+    unsigned long long render_batch();
+    unsigned long long render_parallel(unsigned threads = 0);
+
+    const std::vector<unsigned>& get_iterations() const { return iterations; }
+    void write_pgm(const std::string& filename) const;
+};
+
+FractalRenderer::FractalRenderer(const FractalConfig& config_in) :
+    config(config_in), iterations(config_in.width * config_in.height, 0)
+{
+    if (config.width == 0 || config.height == 0 || config.tile_size == 0) {
+        throw std::invalid_argument("Invalid fractal size");
+    }
+}
+
+// Escape time of a single point, computed with the Complex operators.
+unsigned escape_time(Complex z, const Complex& c, unsigned max_iterations)
+{
+    unsigned n = 0;
+    while (n < max_iterations) {
+        double re = z.get_real();
+        double im = z.get_imaginary();
+        if (re * re + im * im > 4) break;
+        z = z * z + c;
+        ++n;
+    }
+    return n;
+}
+
+unsigned long long FractalRenderer::render_scalar()
+{
+    unsigned long long total = 0;
+    for (std::size_t y = 0; y < config.height; ++y) {
+        for (std::size_t x = 0; x < config.width; ++x) {
+            Complex point{x_at(x), y_at(y)};
+            unsigned n = config.julia ? escape_time(point, config.julia_c, config.max_iterations)
+                                      : escape_time(Complex{0, 0}, point, config.max_iterations);
+            iterations[y * config.width + x] = n;
+            total += n;
+        }
+    }
+    return total;
+}
+
+/*
+Render the pixels [x_begin, x_end) of row y in lanes of batch_size.
+Every lane keeps iterating after it escapes, but its counter is frozen by the
+active mask, so the counts are the same as in escape_time().
+*/
+unsigned long long FractalRenderer::render_span(std::size_t y, std::size_t x_begin, std::size_t x_end)
+{
+    unsigned long long total = 0;
+    double y_value = y_at(y);
+
+    for (std::size_t x = x_begin; x < x_end; x += batch_size) {
+        std::size_t lanes = std::min(batch_size, x_end - x);
+        double zr[batch_size], zi[batch_size], cr[batch_size], ci[batch_size];
+        unsigned count[batch_size];
+        unsigned active[batch_size];
+
+        for (std::size_t l = 0; l < batch_size; ++l) {
+            // Unused lanes repeat the last pixel and are ignored when storing.
+            double x_value = x_at(x + std::min(l, lanes - 1));
+            if (config.julia) {
+                zr[l] = x_value;
+                zi[l] = y_value;
+                cr[l] = config.julia_c.get_real();
+                ci[l] = config.julia_c.get_imaginary();
+            } else {
+                zr[l] = 0;
+                zi[l] = 0;
+                cr[l] = x_value;
+                ci[l] = y_value;
+            }
+            count[l] = 0;
+            active[l] = 1;
+        }
+
+        for (unsigned n = 0; n < config.max_iterations; ++n) {
+            unsigned any = 0;
+            for (std::size_t l = 0; l < batch_size; ++l) {
+                double zr2 = zr[l] * zr[l];
+                double zi2 = zi[l] * zi[l];
+                active[l] &= (zr2 + zi2 <= 4) ? 1u : 0u;
+                count[l] += active[l];
+                any |= active[l];
+                double re = zr2 - zi2 + cr[l];
+                zi[l] = 2 * zr[l] * zi[l] + ci[l];
+                zr[l] = re;
+            }
+            if (!any) break;
+        }
+
+        for (std::size_t l = 0; l < lanes; ++l) {
+            iterations[y * config.width + x + l] = count[l];
+            total += count[l];
+        }
+    }
+    return total;
+}
+
+unsigned long long FractalRenderer::render_batch()
+{
+    unsigned long long total = 0;
+    for (std::size_t y = 0; y < config.height; ++y) {
+        total += render_span(y, 0, config.width);
+    }
+    return total;
+}
+
+unsigned long long FractalRenderer::render_parallel(unsigned threads)
+{
+    if (threads == 0) threads = default_thread_count();
+
+    std::size_t tiles_x = (config.width + config.tile_size - 1) / config.tile_size;
+    std::size_t tiles_y = (config.height + config.tile_size - 1) / config.tile_size;
+    std::size_t tile_count = tiles_x * tiles_y;
+    std::atomic<std::size_t> next_tile{0};
+    std::atomic<unsigned long long> total{0};
+
+    // Each thread grabs the next tile until none are left.
+    auto worker = [&]() {
+        unsigned long long local = 0;
+        for (std::size_t tile = next_tile++; tile < tile_count; tile = next_tile++) {
+            std::size_t x_begin = (tile % tiles_x) * config.tile_size;
+            std::size_t y_begin = (tile / tiles_x) * config.tile_size;
+            std::size_t x_end = std::min(config.width, x_begin + config.tile_size);
+            std::size_t y_end = std::min(config.height, y_begin + config.tile_size);
+            for (std::size_t y = y_begin; y < y_end; ++y) {
+                local += render_span(y, x_begin, x_end);
+            }
+        }
+        total += local;
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+    return total;
+}
+
+// Points inside the set are black, the rest are shaded by the square root of their escape time.
+void FractalRenderer::write_pgm(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.good()) {
+        throw std::runtime_error("Could not open " + filename);
+    }
+
+    file << "P5\n" << config.width << " " << config.height << "\n255\n";
+    std::vector<unsigned char> pixels(iterations.size());
+    for (std::size_t i = 0; i < iterations.size(); ++i) {
+        unsigned n = iterations[i];
+        pixels[i] = n >= config.max_iterations ? 0 :
+                    static_cast<unsigned char>(255 * std::sqrt(static_cast<double>(n) / config.max_iterations));
+    }
+    file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+}
+
+#endif
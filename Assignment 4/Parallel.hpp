@@ -0,0 +1,51 @@
+/*
+This file defines a small helper that splits a loop over [0, n) into
+contiguous chunks and runs every chunk on its own std::thread.
+*/
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// Number of threads used when the caller passes 0.
+unsigned default_thread_count()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+/*
+Call fn(begin, end) for contiguous chunks covering [0, n).
+The calling thread processes the first chunk itself; with threads == 1 no thread is started.
+*/
+template <typename F>
+void parallel_for(std::size_t n, unsigned threads, F&& fn)
+{
+    if (threads == 0) threads = default_thread_count();
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, n));
+    if (threads <= 1) {
+        if (n > 0) fn(std::size_t{0}, n);
+        return;
+    }
+
+    std::size_t chunk = (n + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        std::size_t begin = t * chunk;
+        std::size_t end = std::min(n, begin + chunk);
+        if (begin >= end) break;
+        workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    fn(std::size_t{0}, std::min(n, chunk));
+
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+}
+
+#endif
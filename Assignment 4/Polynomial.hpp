@@ -0,0 +1,326 @@
+/*
+This file defines the Polynomial class template, a polynomial whose coefficients
+and variable are of the same type T. It is meant to be used as Polynomial<Complex>:
+evaluation and root finding only use the arithmetic operators of Complex.
+*/
+
+#ifndef POLYNOMIAL_HPP
+#define POLYNOMIAL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include "Complex.hpp"
+#include "Parallel.hpp"
+
+/*
+Enum name: RootMethod
+- aberth:        Aberth-Ehrlich iteration (cubic convergence for simple roots).
+- durand_kerner: Weierstrass / Durand-Kerner iteration (quadratic convergence).
+                 Simpler, but less robust than Aberth: from degree 100 or so it usually does not
+                 converge within the default 500 iterations. Use aberth for high degrees.
+*/
+enum class RootMethod { aberth, durand_kerner };
+
+/*
+Result of Polynomial::roots().
+- roots:        the final estimates, one per root, converged or not.
+- converged:    every estimate met the tolerance before max_iterations ran out.
+- iterations:   number of iterations run.
+- max_residual: largest |p(z)| / sum |c_k| |z|^k over the estimates. Around 1e-16 for a root
+                found to machine precision; also meaningful when the iteration did not converge.
+*/
+template <typename T>
+struct PolynomialRoots
+{
+    std::vector<T> roots;
+    bool converged = false;
+    unsigned iterations = 0;
+    double max_residual = 0;
+};
+
+/*
+Class name: Polynomial
+--------------------
+Description: p(x) = c[0] + c[1] x + ... + c[n] x^n
+The coefficients are stored in ascending order of power.
+----------------------------------------
+Attributes:
+- coefficients: (vector of T) the coefficients, coefficients[k] multiplies x^k.
+----------------------------------------
+Methods:
+- Polynomial(std::vector<T> coefficients_in)
+    Parameterized constructor. Throws std::invalid_argument if no coefficient is given.
+- degree(), get_coefficients()
+    Getters.
+- operator()(const T& x) const
+    Evaluate at a single point with Horner's scheme.
+- evaluate(const std::vector<T>& points, unsigned threads) const
+    Evaluate at many points. The points are split into chunks across threads and
+    inside a chunk the Horner recurrence runs over a block of points at a time,
+    so each coefficient is loaded once per block instead of once per point.
+- derivative() const
+    Return the derivative polynomial.
+- roots(RootMethod method, unsigned max_iterations, double tolerance, unsigned threads) const
+    Find all roots simultaneously. Every iteration computes the corrections of all roots
+    from the previous estimates, so the updates are independent and are split across threads.
+    The estimates are returned even when max_iterations runs out; check converged.
+- relative_residual(const T& x) const
+    |p(x)| / sum |c_k| |x|^k, computed without overflow for large |x|.
+*/
+template <typename T>
+class Polynomial
+{
+private:
+    std::vector<T> coefficients;
+
+    // Number of points evaluated together in one Horner block.
+    static constexpr std::size_t block_size = 64;
+    // Below this degree one root-finding iteration is too cheap to be worth threads.
+    static constexpr std::size_t parallel_roots_degree = 256;
+
+    void evaluate_block(const T* points, std::size_t n, T* values) const;
+    std::pair<T, T> horner(const T& x) const;
+    std::pair<T, T> horner_reversed(const T& y) const;
+    T newton_ratio(const T& x, bool outside) const;
+    std::vector<T> initial_roots() const;
+
+public:
+    Polynomial() = default;
+    Polynomial(std::vector<T> coefficients_in);
+
+    std::size_t degree() const { return coefficients.size() - 1; }
+    const std::vector<T>& get_coefficients() const { return coefficients; }
+
+    T operator()(const T& x) const;
+    std::vector<T> evaluate(const std::vector<T>& points, unsigned threads = 0) const;
+    Polynomial derivative() const;
+    PolynomialRoots<T> roots(RootMethod method = RootMethod::aberth, unsigned max_iterations = 500,
+                             double tolerance = 1e-12, unsigned threads = 1) const;
+    double relative_residual(const T& x) const;
+};
+
+template <typename T>
+Polynomial<T>::Polynomial(std::vector<T> coefficients_in) : coefficients(std::move(coefficients_in))
+{
+    if (coefficients.empty()) {
+        throw std::invalid_argument("A polynomial needs at least one coefficient");
+    }
+}
+
+template <typename T>
+T Polynomial<T>::operator()(const T& x) const
+{
+    T result = coefficients.back();
+    for (std::size_t k = coefficients.size() - 1; k-- > 0;) {
+        result = result * x + coefficients[k];
+    }
+    return result;
+}
+
+// Horner's scheme over a block of points: the outer loop runs over coefficients.
+template <typename T>
+void Polynomial<T>::evaluate_block(const T* points, std::size_t n, T* values) const
+{
+    const T leading = coefficients.back();
+    for (std::size_t j = 0; j < n; ++j) {
+        values[j] = leading;
+    }
+    for (std::size_t k = coefficients.size() - 1; k-- > 0;) {
+        const T c = coefficients[k];
+        for (std::size_t j = 0; j < n; ++j) {
+            values[j] = values[j] * points[j] + c;
+        }
+    }
+}
+
+template <typename T>
+std::vector<T> Polynomial<T>::evaluate(const std::vector<T>& points, unsigned threads) const
+{
+    std::vector<T> values(points.size());
+    parallel_for(points.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i += block_size) {
+            std::size_t n = std::min(block_size, end - i);
+            evaluate_block(points.data() + i, n, values.data() + i);
+        }
+    });
+    return values;
+}
+
+template <typename T>
+Polynomial<T> Polynomial<T>::derivative() const
+{
+    if (coefficients.size() == 1) {
+        return Polynomial<T>{{T{0, 0}}};
+    }
+    std::vector<T> derived;
+    derived.reserve(coefficients.size() - 1);
+    for (std::size_t k = 1; k < coefficients.size(); ++k) {
+        derived.push_back(coefficients[k] * T{static_cast<double>(k), 0});
+    }
+    return Polynomial<T>{derived};
+}
+
+// Return p(x) and p'(x) with a single Horner pass.
+template <typename T>
+std::pair<T, T> Polynomial<T>::horner(const T& x) const
+{
+    T value = coefficients.back();
+    T slope{0, 0};
+    for (std::size_t k = coefficients.size() - 1; k-- > 0;) {
+        slope = slope * x + value;
+        value = value * x + coefficients[k];
+    }
+    return {value, slope};
+}
+
+// Return q(y) and q'(y) for the reversed polynomial q(y) = y^n p(1/y).
+template <typename T>
+std::pair<T, T> Polynomial<T>::horner_reversed(const T& y) const
+{
+    T value = coefficients.front();
+    T slope{0, 0};
+    for (std::size_t k = 1; k < coefficients.size(); ++k) {
+        slope = slope * y + value;
+        value = value * y + coefficients[k];
+    }
+    return {value, slope};
+}
+
+/*
+Newton correction p(x)/p'(x). For |x| > 1 it uses p(x) = x^n q(1/x), which gives
+p(x)/p'(x) = x / (n - y q'(y)/q(y)) with y = 1/x, and never forms x^n.
+*/
+template <typename T>
+T Polynomial<T>::newton_ratio(const T& x, bool outside) const
+{
+    if (!outside) {
+        std::pair<T, T> p = horner(x);
+        return p.first / p.second;
+    }
+    const T one{1, 0};
+    T y = one / x;
+    std::pair<T, T> q = horner_reversed(y);
+    return x / (T{static_cast<double>(degree()), 0} - y * q.second / q.first);
+}
+
+/*
+Initial estimates: equally spaced points on a circle whose radius is the
+geometric mean of the root moduli, |c_0 / c_n|^(1/n). The angle offset breaks
+the symmetry of real-coefficient polynomials, which would otherwise stall the iteration.
+*/
+template <typename T>
+std::vector<T> Polynomial<T>::initial_roots() const
+{
+    std::size_t n = degree();
+    double ratio = coefficients.front().get_modulus() / coefficients.back().get_modulus();
+    double radius = ratio > 0 ? std::pow(ratio, 1.0 / n) : 1.0;
+
+    std::vector<T> estimates;
+    estimates.reserve(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        double angle = 2 * M_PI * k / n + 0.4;
+        estimates.push_back(T{radius * std::cos(angle), radius * std::sin(angle)});
+    }
+    return estimates;
+}
+
+/*
+For |x| > 1 both sides are divided by |x|^n: the numerator is then |q(1/x)| and the
+denominator sum |c_k| |1/x|^(n-k), which are both evaluated without forming x^n.
+*/
+template <typename T>
+double Polynomial<T>::relative_residual(const T& x) const
+{
+    double modulus = x.get_modulus();
+    bool outside = modulus > 1;
+    double r = outside ? 1 / modulus : modulus;
+    double scale = 0;
+    if (outside) {
+        for (auto it = coefficients.begin(); it != coefficients.end(); ++it) scale = scale * r + it->get_modulus();
+    } else {
+        for (auto it = coefficients.rbegin(); it != coefficients.rend(); ++it) scale = scale * r + it->get_modulus();
+    }
+    if (scale == 0) return 0;
+    double value = outside ? horner_reversed(T{1, 0} / x).first.get_modulus() : horner(x).first.get_modulus();
+    return value / scale;
+}
+
+template <typename T>
+PolynomialRoots<T> Polynomial<T>::roots(RootMethod method, unsigned max_iterations,
+                                        double tolerance, unsigned threads) const
+{
+    PolynomialRoots<T> result;
+    std::size_t n = degree();
+    if (n == 0) {
+        result.converged = true;
+        return result;
+    }
+    if (coefficients.back().get_modulus() == 0) {
+        throw std::invalid_argument("The leading coefficient must be non-zero");
+    }
+
+    const T one{1, 0};
+    std::vector<T> z = initial_roots();
+    std::vector<T> next(n);
+    std::vector<char> converged(n, 0);
+    if (n < parallel_roots_degree) threads = 1;
+
+    bool all_converged = false;
+    unsigned iteration = 0;
+    while (!all_converged && iteration < max_iterations) {
+        // Compute every correction from the previous estimates (Jacobi style).
+        parallel_for(n, threads, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k) {
+                if (converged[k]) {
+                    next[k] = z[k];
+                    continue;
+                }
+                // Outside the unit circle z^n overflows quickly, so the reversed
+                // polynomial is evaluated at y = 1/z instead (see newton_ratio).
+                bool outside = z[k].get_modulus() > 1;
+                T y = outside ? one / z[k] : z[k];
+                T correction;
+                if (method == RootMethod::aberth) {
+                    T sum{0, 0};
+                    for (std::size_t j = 0; j < n; ++j) {
+                        if (j != k) sum = sum + one / (z[k] - z[j]);
+                    }
+                    T ratio = newton_ratio(z[k], outside);
+                    correction = ratio / (one - ratio * sum);
+                } else {
+                    T product = coefficients.back();
+                    for (std::size_t j = 0; j < n; ++j) {
+                        if (j != k) product = product * (outside ? one - z[j] * y : z[k] - z[j]);
+                    }
+                    T value = outside ? z[k] * horner_reversed(y).first : horner(z[k]).first;
+                    correction = value / product;
+                }
+                next[k] = z[k] - correction;
+                double step = correction.get_modulus();
+                if (!std::isfinite(step)) {
+                    // Derivative or product vanished: nudge the estimate and try again.
+                    next[k] = z[k] + T{tolerance, tolerance};
+                } else if (step <= tolerance * (1 + next[k].get_modulus())) {
+                    converged[k] = 1;
+                }
+            }
+        });
+        z.swap(next);
+        ++iteration;
+        all_converged = std::all_of(converged.begin(), converged.end(), [](char c) { return c != 0; });
+    }
+
+    result.converged = all_converged;
+    result.iterations = iteration;
+    for (auto it = z.begin(); it != z.end(); ++it) {
+        result.max_residual = std::max(result.max_residual, relative_residual(*it));
+    }
+    result.roots = std::move(z);
+    return result;
+}
+
+#endif
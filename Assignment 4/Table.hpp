@@ -11,6 +11,15 @@ Author: Zhiyu Liu, University of Manchester, 2023.3.3
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <cstddef>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+#include "DisplayWidth.hpp"
+#include <utility>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 /*
 Class name: Table
@@ -23,28 +32,43 @@ Attributes:
 - headers: a vector of strings representing the headers of the table.
 - rows: a vector that consists of the rows of the table, each row is a vector of strings.
         (excluding the header row)
-- columns: a vector that consists of the columns of the table, each column is a vector of strings.
-- max_length_each_col: a vector of integers representing the maximum length in each column.
+- max_length_each_col: a vector of integers representing the maximum length in each column,
+  measured in terminal columns with display_width() so that UTF-8 text lines up.
 ----------------------------------------
 Methods:
 - Table()
     Default constructor.
+- Table(std::vector<std::string> headers_in)
+    Constructor for a table without rows. Rows are added with append_row()/emplace_row().
 - Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in)
     Constructor that uses rows to construct the table
     The first argument is a vector of strings that takes in the table headers.
     The second argument is a 2-dimensional vector of strings that takes in the table rows.
-    The constructor then gets the columns and maximum lengths in each column using the input headers/rows.
+    The arguments are moved into the table, pass them with std::move to avoid any copy.
+    The constructor computes the maximum length in each column directly from the headers/rows.
 - ~Table() {}
     Destructor.
 - get_headers(), get_rows(), get_max_length_each_col()
-    Getter methods to protect the object information.
+    Getter methods to protect the object information. They return const references.
+- rows_span()
+    The rows as a std::span (C++20 only).
+- reserve_rows(std::size_t n)
+    Reserve space for n rows so that appending does not reallocate.
+- append_row(std::vector<std::string> row), emplace_row(Cells&&... cells)
+    Add a row at the end, either moved in or with its cells constructed in place.
+    The column widths are updated. Throws std::out_of_range if the number of cells is wrong.
 - get_columns()
-    A method that returns the columns of the table.
+    A method that returns the columns of the table. They are built on demand and not stored.
     return type: 2-dimensional vector of strings.
-- draw_div_line()
+- draw_div_line(std::ostream& os)
     A method that draws a dividing line between adjacent rows.
-- display_table()
-    A method that prints the formatted table.
+- display_table(std::ostream& os)
+    A method that prints the formatted table to any output stream (std::cout by default).
+    Whole lines are assembled in a buffer and written in blocks of 64 KiB,
+    the stream is flushed once at the end.
+- display_table(int fd)
+    Same as above, but the blocks are written straight to a file descriptor.
+    Flush std::cout first if it is mixed with output to descriptor 1.
 */
 class Table
 {
@@ -52,36 +76,50 @@ private:
     // Attributes
     std::vector<std::string> headers;              
     std::vector<std::vector<std::string>> rows;    
-    std::vector<std::vector<std::string>> columns;  
     std::vector<unsigned> max_length_each_col;
+
+    void check_row(const std::vector<std::string>& row) const;
 public:
     // Constructors and a destructor
     Table() = default;
+    Table(std::vector<std::string> headers_in);
     Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in);
     
     ~Table() {}
 
     // Getters
-    std::vector<std::string> get_headers() const {return headers;}
-    std::vector<std::vector<std::string>> get_rows() const {return rows;}
-    std::vector<unsigned> get_max_length_each_col() const {return max_length_each_col;}
+    const std::vector<std::string>& get_headers() const {return headers;}
+    const std::vector<std::vector<std::string>>& get_rows() const {return rows;}
+    const std::vector<unsigned>& get_max_length_each_col() const {return max_length_each_col;}
+#if __cplusplus >= 202002L
+    std::span<const std::vector<std::string>> rows_span() const {return rows;}
+#endif
+
+    void reserve_rows(std::size_t n) {rows.reserve(n);}
+    void append_row(std::vector<std::string> row);
+    template <typename... Cells> void emplace_row(Cells&&... cells);
 
     // Member functions
     std::vector<std::vector<std::string>> get_columns() const;
-    void draw_div_line() const;
-    void display_table() const;
+    void draw_div_line(std::ostream& os = std::cout) const;
+    void display_table(std::ostream& os = std::cout) const;
+    void display_table(int fd) const;
+
+private:
+    std::string make_div_line() const;
+    template <typename Sink> void render(Sink write_block) const;
     
 };
 
 // Get the maximum length of each column and stores them in a vector of integers.
-std::vector<unsigned> get_max_length(std::vector<std::vector<std::string>> columns)
+std::vector<unsigned> get_max_length(const std::vector<std::vector<std::string>>& columns)
 {
     std::vector<unsigned> vec_max_length;
 
     for (auto it_col = columns.begin(); it_col != columns.end(); ++it_col) {
         unsigned max_length = 0;
         for (auto it_cell = it_col->begin(); it_cell != it_col->end(); ++it_cell) {
-            max_length = std::max(max_length, static_cast<unsigned>(it_cell->length()));
+            max_length = std::max(max_length, static_cast<unsigned>(display_width(*it_cell)));
         }
         vec_max_length.push_back(max_length);
     }
@@ -89,12 +127,60 @@ std::vector<unsigned> get_max_length(std::vector<std::vector<std::string>> colum
     return vec_max_length;
 }
 
+// Widen the maximum lengths to fit one more row.
+void update_max_length(std::vector<unsigned>& max_length_each_col, const std::vector<std::string>& row)
+{
+    for (std::size_t i = 0; i < row.size(); ++i) {
+        max_length_each_col[i] = std::max(max_length_each_col[i], static_cast<unsigned>(display_width(row[i])));
+    }
+}
+
+// Constructor without rows, the widths start at the lengths of the headers.
+Table::Table(std::vector<std::string> headers_in) : headers(std::move(headers_in))
+{
+    max_length_each_col.reserve(headers.size());
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        max_length_each_col.push_back(static_cast<unsigned>(display_width(*it)));
+    }
+}
+
 // Parameterized constructor.
 Table::Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in) :
-    headers(headers_in), rows(rows_in) 
+    Table(std::move(headers_in))
+{
+    rows = std::move(rows_in);
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        check_row(*it);
+        update_max_length(max_length_each_col, *it);
+    }
+}
+
+void Table::check_row(const std::vector<std::string>& row) const
+{
+    if (row.size() != headers.size()) {
+        throw std::out_of_range("Row has " + std::to_string(row.size()) + " cells, expected " +
+                                std::to_string(headers.size()));
+    }
+}
+
+void Table::append_row(std::vector<std::string> row)
 {
-    columns = get_columns();
-    max_length_each_col = get_max_length(columns);
+    check_row(row);
+    update_max_length(max_length_each_col, row);
+    rows.push_back(std::move(row));
+}
+
+template <typename... Cells>
+void Table::emplace_row(Cells&&... cells)
+{
+    if (sizeof...(Cells) != headers.size()) {
+        throw std::out_of_range("Row has " + std::to_string(sizeof...(Cells)) + " cells, expected " +
+                                std::to_string(headers.size()));
+    }
+    std::vector<std::string>& row = rows.emplace_back();
+    row.reserve(sizeof...(Cells));
+    (row.emplace_back(std::forward<Cells>(cells)), ...);
+    update_max_length(max_length_each_col, row);
 }
 
 std::vector<std::vector<std::string>> Table::get_columns() const
@@ -120,43 +206,89 @@ std::vector<std::vector<std::string>> Table::get_columns() const
     return columns;
 }
 
-void Table::draw_div_line() const
+// Build the dividing line once, eg: "+-----+-------+\n".
+std::string Table::make_div_line() const
 {
-    int i = 0;
-    for (auto it = headers.begin(); it != headers.end(); ++it) {
+    std::string line;
+    for (std::size_t i = 0; i < headers.size(); ++i) {
         // The length of each cell is given by the maximum length in its column + 2.
-        std::cout << "+" << std::setfill('-') << std::setw(max_length_each_col.at(i) + 2) << "";
-        ++i;
+        line += '+';
+        line.append(max_length_each_col.at(i) + 2, '-');
     }
-    std::cout << "+" << std::endl;
+    line += "+\n";
+    return line;
 }
 
-void Table::display_table() const
+void Table::draw_div_line(std::ostream& os) const
 {
-    draw_div_line();
+    std::string line = make_div_line();
+    os.write(line.data(), line.size());
+}
 
-    // print headers
-    int i = 0;  // unsigned integer to track the number of columns
-    for (auto it = headers.begin(); it != headers.end(); ++it) {
-        std::cout << "|" << std::setfill(' ') << std::setw(max_length_each_col.at(i) + 2);
-        std::cout << std::right << *it;
-        ++i;
+// Append one row of cells to the buffer, each cell padded to the width of its column + 2.
+void append_table_line(std::string& buffer, const std::vector<std::string>& cells,
+                       const std::vector<unsigned>& widths)
+{
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        const std::string& cell = cells[i];
+        std::size_t width = widths.at(i) + 2;
+        std::size_t cell_width = display_width(cell);
+        std::size_t padding = width > cell_width ? width - cell_width : 0;
+        buffer += '|';
+        buffer.append(padding, ' ');
+        buffer += cell;
     }
-    std::cout << "|" << std::endl;
+    buffer += "|\n";
+}
+
+/*
+Assemble the table line by line in a buffer and hand it to write_block(data, size)
+every time it grows past 64 KiB, so a large table is written in a few big calls.
+*/
+template <typename Sink>
+void Table::render(Sink write_block) const
+{
+    const std::size_t block_size = 1 << 16;
+    const std::string div_line = make_div_line();
+    std::string buffer;
+    buffer.reserve(block_size + 1024);
+
+    // print headers
+    buffer += div_line;
+    append_table_line(buffer, headers, max_length_each_col);
+    buffer += div_line;
 
-    draw_div_line();
-    
     // print rows
-    for (auto it1 = rows.begin(); it1 != rows.end(); ++it1) {
-        i = 0;
-        for (auto it2 = it1->begin(); it2 != it1->end(); ++it2) {
-            std::cout << "|" << std::setfill(' ') << std::setw(max_length_each_col.at(i) + 2);
-            std::cout << std::right << *it2;
-            ++i;
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        append_table_line(buffer, *it, max_length_each_col);
+        buffer += div_line;
+        if (buffer.size() >= block_size) {
+            write_block(buffer.data(), buffer.size());
+            buffer.clear();
         }
-        std::cout << "|" << std::endl;
-        draw_div_line();
     }
+    write_block(buffer.data(), buffer.size());
+}
+
+void Table::display_table(std::ostream& os) const
+{
+    render([&os](const char* data, std::size_t size) { os.write(data, size); });
+    os.flush();
+}
+
+void Table::display_table(int fd) const
+{
+    render([fd](const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Could not write the table");
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    });
 }
 
 template <typename T>
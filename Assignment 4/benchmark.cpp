@@ -0,0 +1,364 @@
+/*
++-----------------------------------------------------+
+| Benchmarks for the Complex number routines          |
++-----------------------------------------------------+
+Build:  g++ -std=c++20 -O3 -pthread benchmark.cpp -o benchmark
+Usage:  ./benchmark [name]
+Without a name every benchmark is run. The timings are printed with Table.hpp.
+*/
+#include "Complex.hpp"
+#include "ComplexBatch.hpp"
+#include "Polynomial.hpp"
+#include "Fractal.hpp"
+#include "ComplexFormat.hpp"
+#include "ComplexIO.hpp"
+#include "Convolution.hpp"
+#include <fstream>
+#include "Table.hpp"
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+// Time a callable and return the elapsed wall time in milliseconds.
+template <typename F>
+double time_ms(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Best of several runs, for kernels short enough that a single run is mostly noise.
+template <typename F>
+double best_time_ms(F&& f, int runs = 7)
+{
+    double best = time_ms(f);
+    for (int r = 1; r < runs; ++r) best = std::min(best, time_ms(f));
+    return best;
+}
+
+// Generate n pseudo-random complex numbers with a fixed seed so runs are reproducible.
+std::vector<Complex> random_complex(std::size_t n, unsigned seed)
+{
+    std::mt19937_64 generator{seed};
+    std::uniform_real_distribution<double> distribution{-10.0, 10.0};
+    std::vector<Complex> numbers;
+    numbers.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        double re = distribution(generator);
+        double im = distribution(generator);
+        numbers.push_back(Complex{re, im});
+    }
+    return numbers;
+}
+
+// Largest relative difference between two arrays, used to report the accuracy of the fast path.
+double max_relative_error(const std::vector<Complex>& a, const std::vector<Complex>& b)
+{
+    double error = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        error = std::max(error, (a[i] - b[i]).get_modulus() / a[i].get_modulus());
+    }
+    return error;
+}
+
+void benchmark_division()
+{
+    const std::size_t n = 8192;
+    const int repeats = 200;
+    std::vector<Complex> numerators = random_complex(n, 1);
+    std::vector<Complex> denominators = random_complex(n, 2);
+    Complex gain{3.7, -1.2};
+    std::vector<Complex> reference(n), quotients(n);
+
+    std::vector<std::string> headers{"Case", "Time (ms)", "Speedup", "Max rel. error"};
+    std::vector<std::vector<std::string>> rows;
+
+    // Array / scalar
+    double t_operator = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            for (std::size_t i = 0; i < n; ++i) reference[i] = numerators[i] / gain;
+    });
+    rows.push_back({"scalar: operator/", to_string_format(t_operator), "1", "0"});
+
+    double t_exact = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            divide<DivisionMode::exact>(numerators.data(), n, gain, quotients.data());
+    });
+    rows.push_back({"scalar: exact", to_string_format(t_exact), to_string_format(t_operator / t_exact),
+                    to_string_format(max_relative_error(reference, quotients))});
+
+    double t_fast = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            divide<DivisionMode::fast>(numerators.data(), n, gain, quotients.data());
+    });
+    rows.push_back({"scalar: fast", to_string_format(t_fast), to_string_format(t_operator / t_fast),
+                    to_string_format(max_relative_error(reference, quotients))});
+
+    // Array / array
+    t_operator = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            for (std::size_t i = 0; i < n; ++i) reference[i] = numerators[i] / denominators[i];
+    });
+    rows.push_back({"array: operator/", to_string_format(t_operator), "1", "0"});
+
+    t_exact = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            divide<DivisionMode::exact>(numerators.data(), denominators.data(), n, quotients.data());
+    });
+    rows.push_back({"array: exact", to_string_format(t_exact), to_string_format(t_operator / t_exact),
+                    to_string_format(max_relative_error(reference, quotients))});
+
+    t_fast = best_time_ms([&] {
+        for (int r = 0; r < repeats; ++r)
+            divide<DivisionMode::fast>(numerators.data(), denominators.data(), n, quotients.data());
+    });
+    rows.push_back({"array: fast", to_string_format(t_fast), to_string_format(t_operator / t_fast),
+                    to_string_format(max_relative_error(reference, quotients))});
+
+    std::cout << "\nBatch division of " << n << " numbers, " << repeats << " repeats:" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+}
+
+void benchmark_polynomial()
+{
+    const std::size_t degree = 64;
+    const std::size_t n = 1000000;
+    Polynomial<Complex> p{random_complex(degree + 1, 3)};
+    std::vector<Complex> points = random_complex(n, 4);
+
+    std::vector<std::string> headers{"Case", "Time (ms)", "Speedup"};
+    std::vector<std::vector<std::string>> rows;
+
+    std::vector<Complex> reference(n);
+    double t_point = time_ms([&] {
+        for (std::size_t i = 0; i < n; ++i) reference[i] = p(points[i]);
+    });
+    rows.push_back({"point by point", to_string_format(t_point), "1"});
+
+    std::vector<Complex> values;
+    double t_block = time_ms([&] { values = p.evaluate(points, 1); });
+    rows.push_back({"blocked, 1 thread", to_string_format(t_block), to_string_format(t_point / t_block)});
+
+    double t_threads = time_ms([&] { values = p.evaluate(points); });
+    rows.push_back({"blocked, " + to_string_format(default_thread_count()) + " threads",
+                    to_string_format(t_threads), to_string_format(t_point / t_threads)});
+
+    std::cout << "\nHorner evaluation of a degree " << degree << " polynomial at " << n << " points:" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+
+    // Root finding: report the time and the largest residual relative to sum |c_k| |z|^k.
+    rows.clear();
+    headers = {"Method", "Time (ms)", "Iterations", "Converged", "Max rel. residual"};
+    RootMethod methods[] = {RootMethod::aberth, RootMethod::durand_kerner};
+    std::string names[] = {"Aberth-Ehrlich", "Durand-Kerner"};
+    for (int m = 0; m < 2; ++m) {
+        PolynomialRoots<Complex> result;
+        double t = time_ms([&] { result = p.roots(methods[m]); });
+        rows.push_back({names[m], to_string_format(t), to_string_format(result.iterations),
+                        result.converged ? "yes" : "no", to_string_format(result.max_residual)});
+    }
+    std::cout << "\nRoots of the same polynomial:" << std::endl;
+    Table root_results{headers, rows};
+    root_results.display_table();
+}
+
+// Render the same image with every mode, print iterations per second and write a PGM file.
+void benchmark_fractal(bool julia)
+{
+    FractalConfig config;
+    if (julia) {
+        config.julia = true;
+        config.x_min = -1.6;
+        config.x_max = 1.6;
+        config.y_min = -1.2;
+        config.y_max = 1.2;
+    }
+    FractalRenderer renderer{config};
+    unsigned threads = default_thread_count();
+
+    std::vector<std::string> headers{"Mode", "Time (ms)", "Iterations/s", "Speedup", "Same image"};
+    std::vector<std::vector<std::string>> rows;
+
+    unsigned long long total = 0;
+    double t_scalar = time_ms([&] { total = renderer.render_scalar(); });
+    std::vector<unsigned> reference = renderer.get_iterations();
+    rows.push_back({"scalar (Complex)", to_string_format(t_scalar),
+                    to_string_format(total / t_scalar * 1e3), "1", "yes"});
+
+    double t_batch = time_ms([&] { total = renderer.render_batch(); });
+    rows.push_back({"batch", to_string_format(t_batch), to_string_format(total / t_batch * 1e3),
+                    to_string_format(t_scalar / t_batch), renderer.get_iterations() == reference ? "yes" : "no"});
+
+    double t_tiles = time_ms([&] { total = renderer.render_parallel(threads); });
+    rows.push_back({"tiles, " + to_string_format(threads) + " threads", to_string_format(t_tiles),
+                    to_string_format(total / t_tiles * 1e3), to_string_format(t_scalar / t_tiles),
+                    renderer.get_iterations() == reference ? "yes" : "no"});
+
+    std::string filename = julia ? "julia.pgm" : "mandelbrot.pgm";
+    renderer.write_pgm(filename);
+
+    std::cout << "\n" << (julia ? "Julia" : "Mandelbrot") << " set, " << config.width << "x" << config.height
+              << ", " << total << " iterations, written to " << filename << ":" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+}
+
+void benchmark_format()
+{
+    const std::size_t n = 1000000;
+    std::vector<Complex> numbers = random_complex(n, 5);
+
+    std::vector<std::string> headers{"Case", "Time (ms)", "MB/s", "Speedup", "Same text"};
+    std::vector<std::vector<std::string>> rows;
+
+    std::ostringstream reference;
+    double t_stream = time_ms([&] {
+        for (std::size_t i = 0; i < n; ++i) reference << numbers[i] << '\n';
+    });
+    std::size_t bytes = reference.str().size();
+    rows.push_back({"operator<<", to_string_format(t_stream), to_string_format(bytes / t_stream / 1e3), "1", "yes"});
+
+    std::ostringstream buffered;
+    double t_writer = time_ms([&] {
+        ComplexWriter writer{buffered};
+        writer.write(numbers);
+    });
+    rows.push_back({"ComplexWriter", to_string_format(t_writer), to_string_format(bytes / t_writer / 1e3),
+                    to_string_format(t_stream / t_writer), buffered.str() == reference.str() ? "yes" : "no"});
+
+    std::ostringstream round_trip;
+    double t_shortest = time_ms([&] {
+        ComplexWriter writer{round_trip, shortest_round_trip};
+        writer.write(numbers);
+    });
+    rows.push_back({"ComplexWriter, shortest", to_string_format(t_shortest),
+                    to_string_format(round_trip.str().size() / t_shortest / 1e3),
+                    to_string_format(t_stream / t_shortest), "-"});
+
+    std::cout << "\nFormatting " << n << " complex numbers:" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+}
+
+// Round trip an array through text (operator<< / operator>>) and through the binary format.
+void benchmark_binary()
+{
+    const std::size_t n = 1000000;
+    std::vector<Complex> numbers = random_complex(n, 6);
+
+    std::vector<std::string> headers{"Case", "Write (ms)", "Read (ms)", "File size (MB)", "Exact"};
+    std::vector<std::vector<std::string>> rows;
+
+    double t_write = time_ms([&] {
+        std::ofstream file("complex.txt");
+        ComplexWriter writer{file};
+        writer.write(numbers);
+    });
+    std::vector<Complex> from_text(n);
+    double t_read = time_ms([&] {
+        std::ifstream file("complex.txt");
+        for (std::size_t i = 0; i < n; ++i) file >> from_text[i];
+    });
+    bool exact = true;
+    for (std::size_t i = 0; i < n; ++i) {
+        exact = exact && from_text[i].get_real() == numbers[i].get_real()
+                      && from_text[i].get_imaginary() == numbers[i].get_imaginary();
+    }
+    rows.push_back({"text", to_string_format(t_write), to_string_format(t_read),
+                    to_string_format(std::ifstream("complex.txt", std::ios::ate).tellg() / 1e6), exact ? "yes" : "no"});
+
+    ComplexLayout layouts[] = {ComplexLayout::interleaved, ComplexLayout::split};
+    std::string names[] = {"binary, interleaved", "binary, split 64k chunks"};
+    for (int l = 0; l < 2; ++l) {
+        t_write = time_ms([&] { write_complex_array("complex.cpxa", numbers, layouts[l], 65536); });
+        std::vector<Complex> from_binary;
+        t_read = time_ms([&] {
+            MappedComplexArray file{"complex.cpxa"};
+            from_binary = file.to_vector();
+        });
+        exact = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            exact = exact && from_binary[i].get_real() == numbers[i].get_real()
+                          && from_binary[i].get_imaginary() == numbers[i].get_imaginary();
+        }
+        rows.push_back({names[l], to_string_format(t_write), to_string_format(t_read),
+                        to_string_format(std::ifstream("complex.cpxa", std::ios::ate).tellg() / 1e6),
+                        exact ? "yes" : "no"});
+    }
+
+    // Opening the mapping and viewing it as a span does not touch the data at all.
+    t_write = time_ms([&] { write_complex_array("complex.cpxa", numbers); });
+    Complex first;
+    t_read = time_ms([&] {
+        MappedComplexArray file{"complex.cpxa"};
+        first = file.values().front();
+    });
+    rows.push_back({"binary, mmap span only", to_string_format(t_write), to_string_format(t_read), "-", "-"});
+
+    std::remove("complex.txt");
+    std::remove("complex.cpxa");
+
+    std::cout << "\nSaving and loading " << n << " complex numbers:" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+}
+
+void benchmark_convolution()
+{
+    const std::size_t n = 200000;
+    std::vector<Complex> signal = random_complex(n, 7);
+
+    std::vector<std::string> headers{"Filter taps", "Method", "Time (ms)", "Speedup", "Max abs. error"};
+    std::vector<std::vector<std::string>> rows;
+
+    std::size_t taps[] = {16, 256, 2048};
+    for (int t = 0; t < 3; ++t) {
+        std::size_t m = taps[t];
+        std::vector<Complex> filter = random_complex(m, 8);
+
+        // The O(n m) loop over Complex::operator* and operator+ that callers used to write.
+        // Allocating the output is timed as well, like in convolve().
+        std::vector<Complex> reference;
+        double t_loop = time_ms([&] {
+            reference.assign(n + m - 1, Complex{0, 0});
+            for (std::size_t i = 0; i < n; ++i)
+                for (std::size_t j = 0; j < m; ++j)
+                    reference[i + j] = reference[i + j] + signal[i] * filter[j];
+        });
+        rows.push_back({to_string_format(m), "operator loop", to_string_format(t_loop), "1", "0"});
+
+        ConvolutionMethod methods[] = {ConvolutionMethod::direct, ConvolutionMethod::fft};
+        std::string names[] = {"direct", "fft overlap-add"};
+        for (int k = 0; k < 2; ++k) {
+            std::vector<Complex> out;
+            double t_method = time_ms([&] { out = convolve(signal, filter, methods[k]); });
+            double error = 0;
+            for (std::size_t i = 0; i < out.size(); ++i) error = std::max(error, (out[i] - reference[i]).get_modulus());
+            rows.push_back({to_string_format(m), names[k], to_string_format(t_method),
+                            to_string_format(t_loop / t_method), to_string_format(error)});
+        }
+    }
+
+    std::cout << "\nConvolution of " << n << " samples:" << std::endl;
+    Table results{headers, rows};
+    results.display_table();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = argc > 1 ? argv[1] : "all";
+
+    if (name == "all" || name == "division") benchmark_division();
+    if (name == "all" || name == "polynomial") benchmark_polynomial();
+    if (name == "all" || name == "format") benchmark_format();
+    if (name == "all" || name == "binary") benchmark_binary();
+    if (name == "all" || name == "convolution") benchmark_convolution();
+    if (name == "all" || name == "mandelbrot") benchmark_fractal(false);
+    if (name == "all" || name == "julia") benchmark_fractal(true);
+
+    return 0;
+}
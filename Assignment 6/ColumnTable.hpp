@@ -0,0 +1,438 @@
+/*
+This file defines the ColumnTable class, a table that stores its columns as typed vectors
+(double, 64-bit integer or string) instead of a vector of string rows.
+Numbers are only turned into text while the table is printed.
+*/
+
+#ifndef COLUMN_TABLE_HPP
+#define COLUMN_TABLE_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include <unistd.h>
+#include "TableStream.hpp"
+#include "Parallel.hpp"
+#include "DisplayWidth.hpp"
+
+enum class ColumnType { real, integer, text };
+
+// Precision value that prints the shortest text which reads back to the same double.
+const int shortest_round_trip = -1;
+
+/*
+Class name: ColumnTable
+--------------------
+Description: A table made of typed columns, printed in the same bordered format as Table.
+Cells are formatted with std::to_chars into a small stack buffer twice, once to measure the
+column widths and once while rendering, so no string is allocated per cell. Real columns use
+printf "%g" rules with the column precision (6 by default, like to_string_format), so the output
+matches a Table built from to_string_format() cells.
+----------------------------------------
+Attributes:
+- columns: (vector of Column) header, type, precision, alignment and values of each column.
+  Only the vector that matches the type of a column is used.
+- row_count: number of rows.
+----------------------------------------
+Methods:
+- add_real_column(std::string header, int precision, Alignment alignment)
+- add_integer_column(std::string header, Alignment alignment)
+- add_text_column(std::string header, Alignment alignment)
+    Add an empty column and return its index. Columns can only be added while the table has no rows.
+- set_precision(std::size_t column, int precision), set_alignment(std::size_t column, Alignment alignment)
+    Change how a column is printed. A precision is shortest_round_trip or 0 to max_precision
+    digits; add_real_column() and set_precision() throw std::invalid_argument for any other.
+- reserve(std::size_t n)
+    Reserve space for n rows in every column.
+- append_row(Cells&&... cells)
+    Add a row, one cell per column. Any arithmetic type goes into a real column, integral types into
+    an integer column and anything convertible to std::string_view into a text column.
+    Throws std::invalid_argument for a wrong number of cells or a cell of the wrong type.
+- row_count(), column_count(), get_header(i), get_type(i)
+    Getters.
+- reals(i), integers(i), texts(i)
+    The values of a column. Throws std::invalid_argument if the column has another type.
+- take(const std::vector<std::size_t>& row_indices)
+    A new table with the same columns and the given rows, in the given order.
+- cell_text(std::size_t row, std::size_t column, char* scratch)
+    The printed text of one cell. Numbers are written into scratch (max_number_length characters).
+- column_widths(unsigned threads)
+    Width of each column, the longest formatted cell or header.
+    With threads > 1 (0 = every hardware thread) chunks of rows are measured on separate threads
+    and their widths combined with a max-reduction.
+- display_table(std::ostream& os, unsigned threads), display_table(int fd, unsigned threads)
+    Print the table. With threads > 1 chunks of rows are formatted on separate threads and
+    written in order, the output is the same.
+*/
+class ColumnTable
+{
+private:
+    struct Column
+    {
+        std::string header;
+        ColumnType type;
+        int precision;
+        Alignment alignment;
+        std::vector<double> reals;
+        std::vector<std::int64_t> integers;
+        std::vector<std::string> texts;
+    };
+
+    std::vector<Column> columns;
+    std::size_t rows = 0;
+
+    std::size_t add_column(std::string header, ColumnType type, int precision, Alignment alignment);
+    const Column& column_of_type(std::size_t i, ColumnType type) const;
+    template <typename Cell> void append_cell(std::size_t i, Cell&& cell);
+    std::string_view format_cell(const Column& column, std::size_t row, char* scratch) const;
+    void append_cell_text(std::string& buffer, std::string_view text, std::size_t width, Alignment alignment) const;
+    void append_rows(std::string& buffer, const std::string& div_line, const std::vector<std::size_t>& widths,
+                     std::size_t begin, std::size_t end) const;
+    template <typename Sink> void render(Sink write_block, unsigned threads) const;
+
+public:
+    // Longest text of a formatted number, and the precision that keeps every real under it:
+    // 17 digits tell any two doubles apart and take at most 24 characters with sign and exponent.
+    static constexpr std::size_t max_number_length = 64;
+    static constexpr int max_precision = 17;
+
+    ColumnTable() = default;
+
+    std::size_t add_real_column(std::string header, int precision = 6, Alignment alignment = Alignment::right);
+    std::size_t add_integer_column(std::string header, Alignment alignment = Alignment::right);
+    std::size_t add_text_column(std::string header, Alignment alignment = Alignment::right);
+    void set_precision(std::size_t column, int precision);
+    void set_alignment(std::size_t column, Alignment alignment) { columns.at(column).alignment = alignment; }
+
+    void reserve(std::size_t n);
+    template <typename... Cells> void append_row(Cells&&... cells);
+
+    std::size_t row_count() const { return rows; }
+    std::size_t column_count() const { return columns.size(); }
+    const std::string& get_header(std::size_t i) const { return columns.at(i).header; }
+    ColumnType get_type(std::size_t i) const { return columns.at(i).type; }
+    int get_precision(std::size_t i) const { return columns.at(i).precision; }
+    Alignment get_alignment(std::size_t i) const { return columns.at(i).alignment; }
+    const std::vector<double>& reals(std::size_t i) const { return column_of_type(i, ColumnType::real).reals; }
+    const std::vector<std::int64_t>& integers(std::size_t i) const { return column_of_type(i, ColumnType::integer).integers; }
+    const std::vector<std::string>& texts(std::size_t i) const { return column_of_type(i, ColumnType::text).texts; }
+
+    ColumnTable take(const std::vector<std::size_t>& row_indices) const;
+    std::string_view cell_text(std::size_t row, std::size_t column, char* scratch) const;
+    std::vector<std::size_t> column_widths(unsigned threads = 1) const;
+    void display_table(std::ostream& os = std::cout, unsigned threads = 1) const;
+    void display_table(int fd, unsigned threads = 1) const;
+};
+
+std::size_t ColumnTable::add_column(std::string header, ColumnType type, int precision, Alignment alignment)
+{
+    if (rows > 0) {
+        throw std::logic_error("Columns cannot be added to a table that has rows");
+    }
+    columns.push_back(Column{std::move(header), type, precision, alignment, {}, {}, {}});
+    return columns.size() - 1;
+}
+
+void check_column_precision(int precision)
+{
+    if (precision != shortest_round_trip && (precision < 0 || precision > ColumnTable::max_precision)) {
+        throw std::invalid_argument("Precision must be shortest_round_trip or 0 to " +
+                                    std::to_string(ColumnTable::max_precision));
+    }
+}
+
+std::size_t ColumnTable::add_real_column(std::string header, int precision, Alignment alignment)
+{
+    check_column_precision(precision);
+    return add_column(std::move(header), ColumnType::real, precision, alignment);
+}
+
+void ColumnTable::set_precision(std::size_t column, int precision)
+{
+    check_column_precision(precision);
+    columns.at(column).precision = precision;
+}
+
+std::size_t ColumnTable::add_integer_column(std::string header, Alignment alignment)
+{
+    return add_column(std::move(header), ColumnType::integer, 0, alignment);
+}
+
+std::size_t ColumnTable::add_text_column(std::string header, Alignment alignment)
+{
+    return add_column(std::move(header), ColumnType::text, 0, alignment);
+}
+
+const ColumnTable::Column& ColumnTable::column_of_type(std::size_t i, ColumnType type) const
+{
+    const Column& column = columns.at(i);
+    if (column.type != type) {
+        throw std::invalid_argument("Column " + column.header + " has another type");
+    }
+    return column;
+}
+
+void ColumnTable::reserve(std::size_t n)
+{
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+        if (it->type == ColumnType::real) it->reals.reserve(n);
+        else if (it->type == ColumnType::integer) it->integers.reserve(n);
+        else it->texts.reserve(n);
+    }
+}
+
+template <typename Cell>
+void ColumnTable::append_cell(std::size_t i, Cell&& cell)
+{
+    using T = std::decay_t<Cell>;
+    Column& column = columns[i];
+
+    if constexpr (std::is_arithmetic_v<T>) {
+        if (column.type == ColumnType::real) {
+            column.reals.push_back(static_cast<double>(cell));
+            return;
+        }
+        if constexpr (std::is_integral_v<T>) {
+            if (column.type == ColumnType::integer) {
+                column.integers.push_back(static_cast<std::int64_t>(cell));
+                return;
+            }
+        }
+    } else if constexpr (std::is_convertible_v<Cell, std::string_view>) {
+        if (column.type == ColumnType::text) {
+            column.texts.emplace_back(std::forward<Cell>(cell));
+            return;
+        }
+    }
+    throw std::invalid_argument("Cell of the wrong type for column " + column.header);
+}
+
+template <typename... Cells>
+void ColumnTable::append_row(Cells&&... cells)
+{
+    if (sizeof...(Cells) != columns.size()) {
+        throw std::invalid_argument("Row has " + std::to_string(sizeof...(Cells)) + " cells, expected " +
+                                    std::to_string(columns.size()));
+    }
+    // Store the cells in order; if one has the wrong type, remove the ones already stored,
+    // so a bad row leaves the columns the same length.
+    std::size_t i = 0;
+    try {
+        (append_cell(i++, std::forward<Cells>(cells)), ...);
+    } catch (...) {
+        for (std::size_t j = 0; j + 1 < i; ++j) {
+            Column& column = columns[j];
+            if (column.type == ColumnType::real) column.reals.pop_back();
+            else if (column.type == ColumnType::integer) column.integers.pop_back();
+            else column.texts.pop_back();
+        }
+        throw;
+    }
+    ++rows;
+}
+
+// Text of one cell. Numbers are written into scratch, which must hold max_number_length characters.
+std::string_view ColumnTable::format_cell(const Column& column, std::size_t row, char* scratch) const
+{
+    std::to_chars_result result;
+    switch (column.type) {
+    case ColumnType::text:
+        return column.texts[row];
+    case ColumnType::integer:
+        result = std::to_chars(scratch, scratch + max_number_length, column.integers[row]);
+        break;
+    default:
+        if (column.precision == shortest_round_trip) {
+            result = std::to_chars(scratch, scratch + max_number_length, column.reals[row]);
+        } else {
+            result = std::to_chars(scratch, scratch + max_number_length, column.reals[row],
+                                   std::chars_format::general, column.precision);
+        }
+        // Cannot happen with a checked precision. The shortest form always fits, and this may
+        // run on a worker thread, where an exception would end the program.
+        if (result.ec != std::errc{}) {
+            result = std::to_chars(scratch, scratch + max_number_length, column.reals[row]);
+        }
+        break;
+    }
+    return std::string_view(scratch, result.ptr - scratch);
+}
+
+ColumnTable ColumnTable::take(const std::vector<std::size_t>& row_indices) const
+{
+    ColumnTable result;
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+        result.add_column(it->header, it->type, it->precision, it->alignment);
+    }
+    result.reserve(row_indices.size());
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+        const Column& from = columns[i];
+        Column& to = result.columns[i];
+        for (auto it = row_indices.begin(); it != row_indices.end(); ++it) {
+            if (from.type == ColumnType::real) to.reals.push_back(from.reals.at(*it));
+            else if (from.type == ColumnType::integer) to.integers.push_back(from.integers.at(*it));
+            else to.texts.push_back(from.texts.at(*it));
+        }
+    }
+    result.rows = row_indices.size();
+    return result;
+}
+
+std::string_view ColumnTable::cell_text(std::size_t row, std::size_t column, char* scratch) const
+{
+    return format_cell(columns.at(column), row, scratch);
+}
+
+std::vector<std::size_t> ColumnTable::column_widths(unsigned threads) const
+{
+    if (threads == 0) threads = default_thread_count();
+    // Rows per chunk below which another thread costs more than it saves.
+    const std::size_t min_chunk_rows = 16384;
+    std::size_t n_chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, rows / min_chunk_rows));
+
+    std::vector<std::size_t> widths;
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+        widths.push_back(display_width(it->header));
+    }
+    std::vector<std::vector<std::size_t>> chunk_widths(n_chunks, widths);
+
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        char scratch[max_number_length];
+        for (std::size_t k = first; k < last; ++k) {
+            std::size_t begin = rows * k / n_chunks, end = rows * (k + 1) / n_chunks;
+            // Column by column, so every pass reads one contiguous vector.
+            for (std::size_t i = 0; i < columns.size(); ++i) {
+                std::size_t width = chunk_widths[k][i];
+                for (std::size_t row = begin; row < end; ++row) {
+                    width = std::max(width, display_width(format_cell(columns[i], row, scratch)));
+                }
+                chunk_widths[k][i] = width;
+            }
+        }
+    });
+
+    for (auto it = chunk_widths.begin(); it != chunk_widths.end(); ++it) {
+        for (std::size_t i = 0; i < widths.size(); ++i) {
+            widths[i] = std::max(widths[i], (*it)[i]);
+        }
+    }
+    return widths;
+}
+
+// Pad the text to width + 2 characters: two spaces of margin, then the aligned text.
+void ColumnTable::append_cell_text(std::string& buffer, std::string_view text, std::size_t width,
+                                   Alignment alignment) const
+{
+    std::size_t padding = width + 2 - display_width(text);
+    buffer += '|';
+    if (alignment == Alignment::right) buffer.append(padding, ' ');
+    buffer.append(text.data(), text.size());
+    if (alignment == Alignment::left) buffer.append(padding, ' ');
+}
+
+void ColumnTable::append_rows(std::string& buffer, const std::string& div_line,
+                              const std::vector<std::size_t>& widths, std::size_t begin, std::size_t end) const
+{
+    char scratch[max_number_length];
+    for (std::size_t row = begin; row < end; ++row) {
+        for (std::size_t i = 0; i < columns.size(); ++i) {
+            append_cell_text(buffer, format_cell(columns[i], row, scratch), widths[i], columns[i].alignment);
+        }
+        buffer += "|\n";
+        buffer += div_line;
+    }
+}
+
+/*
+Assemble the table line by line in a buffer and hand it to write_block(data, size)
+every time it grows past 64 KiB, like Table::render(). With several threads, batches of rows
+are split into one chunk per thread, rendered at the same time and handed over in order.
+*/
+template <typename Sink>
+void ColumnTable::render(Sink write_block, unsigned threads) const
+{
+    const std::size_t block_size = 1 << 16;
+    if (threads == 0) threads = default_thread_count();
+    const std::vector<std::size_t> widths = column_widths(threads);
+
+    std::string div_line;
+    for (auto it = widths.begin(); it != widths.end(); ++it) {
+        div_line += '+';
+        div_line.append(*it + 2, '-');
+    }
+    div_line += "+\n";
+
+    std::string buffer;
+    buffer.reserve(block_size + 1024);
+
+    // print headers
+    buffer += div_line;
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+        append_cell_text(buffer, columns[i].header, widths[i], columns[i].alignment);
+    }
+    buffer += "|\n";
+    buffer += div_line;
+
+    if (threads > 1) {
+        write_block(buffer.data(), buffer.size());
+
+        const std::size_t chunk_rows = 16384;
+        std::vector<std::string> parts(threads);
+        for (std::size_t batch = 0; batch < rows; batch += threads * chunk_rows) {
+            std::size_t batch_end = std::min(rows, batch + threads * chunk_rows);
+            std::size_t n_chunks = (batch_end - batch + chunk_rows - 1) / chunk_rows;
+            parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+                for (std::size_t k = first; k < last; ++k) {
+                    parts[k].clear();
+                    append_rows(parts[k], div_line, widths, batch + k * chunk_rows,
+                                std::min(batch_end, batch + (k + 1) * chunk_rows));
+                }
+            });
+            for (std::size_t k = 0; k < n_chunks; ++k) {
+                write_block(parts[k].data(), parts[k].size());
+            }
+        }
+        return;
+    }
+
+    // print rows
+    for (std::size_t row = 0; row < rows; ++row) {
+        append_rows(buffer, div_line, widths, row, row + 1);
+        if (buffer.size() >= block_size) {
+            write_block(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    write_block(buffer.data(), buffer.size());
+}
+
+void ColumnTable::display_table(std::ostream& os, unsigned threads) const
+{
+    render([&os](const char* data, std::size_t size) { os.write(data, size); }, threads);
+    os.flush();
+}
+
+void ColumnTable::display_table(int fd, unsigned threads) const
+{
+    render([fd](const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Could not write the table");
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }, threads);
+}
+
+#endif
@@ -0,0 +1,388 @@
+/*
+This file defines the CsvReader class, which maps a CSV file (RFC 4180) into memory
+and splits it into cells without copying them. Large files are parsed on several threads.
+*/
+
+#ifndef CSV_READER_HPP
+#define CSV_READER_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+#include "Table.hpp"
+#include "TableStream.hpp"
+
+/*
+SWAR ("SIMD within a register") helpers: eight bytes are tested at once in a 64-bit word.
+byte_mask(word, c) has the high bit of every byte that equals c set, and nothing else.
+*/
+const std::uint64_t swar_low_bits = 0x0101010101010101ULL;
+const std::uint64_t swar_high_bits = 0x8080808080808080ULL;
+
+std::uint64_t byte_mask(std::uint64_t word, char c)
+{
+    std::uint64_t x = word ^ (swar_low_bits * static_cast<unsigned char>(c));
+    // A byte of x is zero exactly where word had c; this form has no false positives.
+    return ~(((x & ~swar_high_bits) + ~swar_high_bits) | x | ~swar_high_bits);
+}
+
+std::uint64_t load_word(const char* p)
+{
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// Index of the first marked byte of a non-zero mask, in memory order (little endian).
+std::size_t first_marked_byte(std::uint64_t mask)
+{
+    return static_cast<std::size_t>(__builtin_ctzll(mask)) / 8;
+}
+
+// First delimiter or newline in [p, end), or end.
+const char* find_field_end(const char* p, const char* end, char delimiter)
+{
+    for (; end - p >= 8; p += 8) {
+        std::uint64_t word = load_word(p);
+        std::uint64_t mask = byte_mask(word, delimiter) | byte_mask(word, '\n');
+        if (mask != 0) return p + first_marked_byte(mask);
+    }
+    for (; p < end; ++p) {
+        if (*p == delimiter || *p == '\n') return p;
+    }
+    return end;
+}
+
+// Number of double quotes in [p, end).
+std::size_t count_quotes(const char* p, const char* end)
+{
+    std::size_t count = 0;
+    for (; end - p >= 8; p += 8) {
+        count += static_cast<std::size_t>(__builtin_popcountll(byte_mask(load_word(p), '"')));
+    }
+    for (; p < end; ++p) {
+        count += *p == '"';
+    }
+    return count;
+}
+
+/*
+Class name: CsvReader
+--------------------
+Description: Reads a whole CSV file through a memory mapping. Every cell is a std::string_view
+into the mapping, so the file has to stay mapped (the reader alive) while the cells are used.
+Quoted cells are viewed without their outer quotes; a cell that still contains doubled quotes
+("") is flagged, and value() returns it unescaped. Lines may end with LF or CRLF, empty lines
+are skipped and every row must have the same number of cells.
+
+With several threads the file is cut into chunks. A chunk boundary is moved to the first newline
+that lies outside quotes, found from the parity of the quotes before it, so every chunk holds
+whole rows. This assumes quotes only appear around quoted fields, as RFC 4180 requires; files
+with stray quotes inside unquoted fields must be read with threads = 1.
+----------------------------------------
+Attributes:
+- file: (MappedFile) the mapped bytes.
+- headers: (vector of strings) the first row, unescaped, when the file has a header.
+- cells: (vector of string_view) all cells row after row, cells[row * columns + column].
+- escaped: (vector of char) 1 for the cells that contain doubled quotes.
+----------------------------------------
+Methods:
+- CsvReader(const std::string& filename, char delimiter, bool has_header, unsigned threads)
+    Map and parse the file. threads == 0 uses every hardware thread.
+    Throws std::runtime_error for a file that cannot be read or is malformed, naming the
+    first bad row in file order whatever the number of threads.
+- row_count(), column_count(), get_headers()
+    Getters. Without a header the headers are "1", "2", ...
+- cell(std::size_t row, std::size_t column), is_escaped(row, column), value(row, column)
+    The raw view of a cell, whether it needs unescaping and the unescaped text.
+- row(std::size_t r)
+    The raw cells of a row as a std::span<const std::string_view>.
+- display_table(std::ostream& os, Alignment alignment)
+    Print the file in the bordered format of Table through TableStream. Only rows that
+    have escaped cells are copied.
+- to_table()
+    Copy the cells into a Table, for code that needs one.
+*/
+class CsvReader
+{
+private:
+    // The cells of one chunk of the file.
+    struct Chunk
+    {
+        std::vector<std::string_view> cells;
+        std::vector<char> escaped;
+        std::size_t columns = 0;
+        std::size_t rows = 0;
+        std::size_t bad_row = SIZE_MAX;     // First row whose width differs from the first one.
+        std::string error;                  // Why parsing stopped at row `rows`, empty if it did not.
+    };
+
+    MappedFile file;
+    char delimiter;
+    std::vector<std::string> headers;
+    std::vector<std::string_view> cells;
+    std::vector<char> escaped;
+    std::size_t columns = 0;
+    std::size_t rows = 0;
+
+    // Chunks smaller than this are not worth a thread.
+    static const std::size_t min_chunk_size = 1 << 20;
+
+    std::vector<const char*> split_points(const char* begin, const char* end, unsigned threads) const;
+    void parse_chunk(const char* begin, const char* end, Chunk& chunk) const;
+
+public:
+    CsvReader(const std::string& filename, char delimiter_in = ',', bool has_header = true, unsigned threads = 0);
+
+    std::size_t row_count() const { return rows; }
+    std::size_t column_count() const { return columns; }
+    const std::vector<std::string>& get_headers() const { return headers; }
+
+    std::string_view cell(std::size_t row, std::size_t column) const { return cells[row * columns + column]; }
+    bool is_escaped(std::size_t row, std::size_t column) const { return escaped[row * columns + column] != 0; }
+    std::string value(std::size_t row, std::size_t column) const;
+    std::span<const std::string_view> row(std::size_t r) const { return {cells.data() + r * columns, columns}; }
+
+    void display_table(std::ostream& os = std::cout, Alignment alignment = Alignment::right) const;
+    Table to_table() const;
+};
+
+// Replace every doubled quote by a single one.
+std::string unescape_csv(std::string_view text)
+{
+    std::string result;
+    result.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        result += text[i];
+        if (text[i] == '"' && i + 1 < text.size() && text[i + 1] == '"') ++i;
+    }
+    return result;
+}
+
+CsvReader::CsvReader(const std::string& filename, char delimiter_in, bool has_header, unsigned threads) :
+    file(filename), delimiter(delimiter_in)
+{
+    if (delimiter == '"' || delimiter == '\n' || delimiter == '\r') {
+        throw std::invalid_argument("Invalid CSV delimiter");
+    }
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    // Skip a UTF-8 byte order mark.
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) begin += 3;
+
+    std::vector<const char*> points = split_points(begin, end, threads);
+    std::vector<Chunk> chunks(points.size() - 1);
+    parallel_for(chunks.size(), static_cast<unsigned>(chunks.size()), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            parse_chunk(points[k], points[k + 1], chunks[k]);
+        }
+    });
+
+    // Report the first problem in file order, a parse error or a row of another width, then
+    // join the chunks. The chunks record their errors rather than throw, since an exception
+    // cannot leave a worker thread.
+    std::size_t total_cells = 0, row_offset = 0;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        if (columns == 0 && it->rows > 0) columns = it->columns;
+        std::size_t bad = it->rows > 0 && it->columns != columns ? 0 : it->bad_row;
+        std::size_t error_row = it->error.empty() ? SIZE_MAX : it->rows;
+        if (error_row < bad) {
+            throw std::runtime_error(filename + ": row " + std::to_string(row_offset + error_row + 1) + ": " +
+                                     it->error);
+        }
+        if (bad != SIZE_MAX) {
+            throw std::runtime_error(filename + ": row " + std::to_string(row_offset + bad + 1) + " does not have " +
+                                     std::to_string(columns) + " cells");
+        }
+        total_cells += it->cells.size();
+        row_offset += it->rows;
+    }
+    cells.reserve(total_cells);
+    escaped.reserve(total_cells);
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        cells.insert(cells.end(), it->cells.begin(), it->cells.end());
+        escaped.insert(escaped.end(), it->escaped.begin(), it->escaped.end());
+    }
+    rows = row_offset;
+
+    if (has_header && rows > 0) {
+        for (std::size_t i = 0; i < columns; ++i) {
+            headers.push_back(value(0, i));
+        }
+        cells.erase(cells.begin(), cells.begin() + columns);
+        escaped.erase(escaped.begin(), escaped.begin() + columns);
+        --rows;
+    } else {
+        for (std::size_t i = 0; i < columns; ++i) {
+            headers.push_back(std::to_string(i + 1));
+        }
+    }
+}
+
+/*
+Cut [begin, end) into chunks that start at the beginning of a row.
+The quotes of every chunk are counted in parallel; their prefix parity tells whether a chunk
+starts inside a quoted field. Its start is then moved past the first newline outside quotes.
+*/
+std::vector<const char*> CsvReader::split_points(const char* begin, const char* end, unsigned threads) const
+{
+    std::size_t size = static_cast<std::size_t>(end - begin);
+    if (threads == 0) threads = default_thread_count();
+    std::size_t n_chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, size / min_chunk_size));
+    std::size_t chunk_size = size / n_chunks;
+
+    std::vector<const char*> starts(n_chunks + 1);
+    for (std::size_t k = 0; k < n_chunks; ++k) starts[k] = begin + k * chunk_size;
+    starts[n_chunks] = end;
+
+    std::vector<std::size_t> quotes(n_chunks);
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) quotes[k] = count_quotes(starts[k], starts[k + 1]);
+    });
+
+    std::vector<const char*> points{begin};
+    bool inside_quotes = false;
+    for (std::size_t k = 1; k < n_chunks; ++k) {
+        inside_quotes ^= quotes[k - 1] % 2 == 1;
+        // The previous boundary already moved past this chunk start.
+        if (points.back() > starts[k]) continue;
+
+        bool quoted = inside_quotes;
+        const char* p = starts[k];
+        for (; p < end; ++p) {
+            if (*p == '"') quoted = !quoted;
+            else if (*p == '\n' && !quoted) break;
+        }
+        if (p < end) points.push_back(p + 1);
+    }
+    points.push_back(end);
+    return points;
+}
+
+void CsvReader::parse_chunk(const char* begin, const char* end, Chunk& chunk) const
+{
+    const char* p = begin;
+    // Enough for the unquoted cells of a typical file, without a second pass.
+    chunk.cells.reserve(static_cast<std::size_t>(end - begin) / 8);
+    chunk.escaped.reserve(static_cast<std::size_t>(end - begin) / 8);
+
+    while (p < end) {
+        // Skip empty lines.
+        if (*p == '\n') { ++p; continue; }
+        if (*p == '\r' && p + 1 < end && p[1] == '\n') { p += 2; continue; }
+
+        std::size_t row_start = chunk.cells.size();
+        bool row_done = false;
+        while (!row_done) {
+            if (p < end && *p == '"') {
+                // Quoted field: runs to the next quote that is not doubled.
+                const char* q = p + 1;
+                bool has_doubled = false;
+                while (true) {
+                    q = static_cast<const char*>(std::memchr(q, '"', static_cast<std::size_t>(end - q)));
+                    if (q == nullptr) {
+                        chunk.error = "Unterminated quoted CSV field";
+                        return;
+                    }
+                    if (q + 1 < end && q[1] == '"') { has_doubled = true; q += 2; continue; }
+                    break;
+                }
+                chunk.cells.emplace_back(p + 1, static_cast<std::size_t>(q - p - 1));
+                chunk.escaped.push_back(has_doubled);
+                p = q + 1;
+                if (p < end && *p == '\r') ++p;
+                if (p < end && *p != delimiter && *p != '\n') {
+                    chunk.error = "Unexpected character after a quoted CSV field";
+                    return;
+                }
+            } else {
+                const char* q = find_field_end(p, end, delimiter);
+                const char* field_end = q;
+                if ((q == end || *q == '\n') && field_end > p && field_end[-1] == '\r') --field_end;
+                chunk.cells.emplace_back(p, static_cast<std::size_t>(field_end - p));
+                chunk.escaped.push_back(0);
+                p = q;
+            }
+
+            if (p == end) {
+                row_done = true;
+            } else if (*p == '\n') {
+                ++p;
+                row_done = true;
+            } else {
+                // A delimiter: another field follows, possibly empty at the end of the line.
+                ++p;
+                if (p == end || *p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+                    chunk.cells.emplace_back(p, 0);
+                    chunk.escaped.push_back(0);
+                    if (p < end) p += *p == '\r' ? 2 : 1;
+                    row_done = true;
+                }
+            }
+        }
+
+        std::size_t width = chunk.cells.size() - row_start;
+        if (chunk.rows == 0) chunk.columns = width;
+        else if (width != chunk.columns && chunk.bad_row == SIZE_MAX) chunk.bad_row = chunk.rows;
+        ++chunk.rows;
+    }
+}
+
+std::string CsvReader::value(std::size_t row, std::size_t column) const
+{
+    std::string_view text = cell(row, column);
+    return is_escaped(row, column) ? unescape_csv(text) : std::string(text);
+}
+
+void CsvReader::display_table(std::ostream& os, Alignment alignment) const
+{
+    // Measure first. An escaped cell is measured without its doubled quotes.
+    std::vector<std::size_t> widths(columns, 0);
+    for (std::size_t r = 0; r < rows; ++r) {
+        for (std::size_t c = 0; c < columns; ++c) {
+            std::size_t length = is_escaped(r, c) ? display_width(value(r, c)) : display_width(cell(r, c));
+            widths[c] = std::max(widths[c], length);
+        }
+    }
+    TableStream stream{os, headers, widths, alignment};
+
+    std::vector<std::string> unescaped_row;
+    for (std::size_t r = 0; r < rows; ++r) {
+        std::span<const std::string_view> cells_of_row = row(r);
+        bool any_escaped = std::any_of(escaped.begin() + r * columns, escaped.begin() + (r + 1) * columns,
+                                       [](char e) { return e != 0; });
+        if (!any_escaped) {
+            stream.write_row(cells_of_row);
+            continue;
+        }
+        unescaped_row.clear();
+        for (std::size_t c = 0; c < columns; ++c) unescaped_row.push_back(value(r, c));
+        stream.write_row(unescaped_row);
+    }
+    stream.finish();
+    os.flush();
+}
+
+Table CsvReader::to_table() const
+{
+    Table table{headers};
+    table.reserve_rows(rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        std::vector<std::string> cells_of_row;
+        cells_of_row.reserve(columns);
+        for (std::size_t c = 0; c < columns; ++c) cells_of_row.push_back(value(r, c));
+        table.append_row(std::move(cells_of_row));
+    }
+    return table;
+}
+
+#endif
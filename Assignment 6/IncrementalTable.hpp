@@ -0,0 +1,199 @@
+/*
+This file defines the IncrementalTable class, a table that grows one row at a time and
+prints only what changed, for progress tables of long running jobs.
+*/
+
+#ifndef INCREMENTAL_TABLE_HPP
+#define INCREMENTAL_TABLE_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "TableStream.hpp"
+#include "DisplayWidth.hpp"
+
+/*
+Class name: IncrementalTable
+--------------------
+Description: Keeps the rows of a table and the width of each column up to date while rows are
+appended and cells are updated. Widths only ever grow, so every change costs O(row width).
+refresh() prints the new and the updated rows in the bordered format of Table:
+- rows appended since the last refresh are printed once,
+- rows that were already printed and then updated are printed again,
+- the header (with its borders) is printed again before them only when a column got wider,
+  so the rows below it line up again.
+display_table() prints the whole table at its current widths.
+----------------------------------------
+Attributes:
+- os: (std::ostream&) destination of refresh().
+- headers: (vector of strings) table headers.
+- rows: (2-dimensional vector of strings) every row appended so far.
+- widths: (vector of size_t) width of each column, excluding the two padding spaces.
+- printed_rows: number of rows already printed by refresh().
+- dirty_rows: printed rows updated since the last refresh, dirty marks them to avoid duplicates.
+- widths_changed: a column got wider since the header was last printed.
+----------------------------------------
+Methods:
+- IncrementalTable(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in)
+    Widths start at the header lengths.
+- append_row(std::vector<std::string> row)
+    Add a row. Throws std::invalid_argument if it does not have one cell per column.
+- update_cell(std::size_t row, std::size_t column, std::string value)
+    Replace one cell. Throws std::out_of_range for a cell that does not exist.
+- refresh()
+    Print what changed since the last refresh and flush the stream.
+- display_table(std::ostream& os)
+    Print the whole table.
+- row_count(), get_rows(), get_widths()
+    Getters.
+*/
+class IncrementalTable
+{
+private:
+    std::ostream& os;
+    std::vector<std::string> headers;
+    std::vector<std::vector<std::string>> rows;
+    std::vector<std::size_t> widths;
+    Alignment alignment;
+
+    std::size_t printed_rows = 0;
+    std::vector<std::size_t> dirty_rows;
+    std::vector<char> dirty;
+    bool widths_changed = true;
+
+    void widen(std::size_t column, std::size_t length);
+    std::string make_div_line() const;
+    void append_line(std::string& buffer, const std::vector<std::string>& cells) const;
+    void append_header(std::string& buffer, const std::string& div_line) const;
+
+public:
+    IncrementalTable(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in = Alignment::right);
+
+    void append_row(std::vector<std::string> row);
+    void update_cell(std::size_t row, std::size_t column, std::string value);
+    void refresh();
+    void display_table(std::ostream& out) const;
+
+    std::size_t row_count() const { return rows.size(); }
+    const std::vector<std::vector<std::string>>& get_rows() const { return rows; }
+    const std::vector<std::size_t>& get_widths() const { return widths; }
+};
+
+IncrementalTable::IncrementalTable(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in) :
+    os(os_in), headers(std::move(headers_in)), alignment(alignment_in)
+{
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        widths.push_back(display_width(*it));
+    }
+}
+
+void IncrementalTable::widen(std::size_t column, std::size_t length)
+{
+    if (length > widths[column]) {
+        widths[column] = length;
+        widths_changed = true;
+    }
+}
+
+void IncrementalTable::append_row(std::vector<std::string> row)
+{
+    if (row.size() != headers.size()) {
+        throw std::invalid_argument("Row has " + std::to_string(row.size()) + " cells, expected " +
+                                    std::to_string(headers.size()));
+    }
+    for (std::size_t i = 0; i < row.size(); ++i) {
+        widen(i, display_width(row[i]));
+    }
+    rows.push_back(std::move(row));
+    dirty.push_back(0);
+}
+
+void IncrementalTable::update_cell(std::size_t row, std::size_t column, std::string value)
+{
+    std::string& cell = rows.at(row).at(column);
+    widen(column, display_width(value));
+    cell = std::move(value);
+
+    // Rows that were never printed will be printed by the next refresh anyway.
+    if (row < printed_rows && !dirty[row]) {
+        dirty[row] = 1;
+        dirty_rows.push_back(row);
+    }
+}
+
+std::string IncrementalTable::make_div_line() const
+{
+    std::string line;
+    for (auto it = widths.begin(); it != widths.end(); ++it) {
+        line += '+';
+        line.append(*it + 2, '-');
+    }
+    line += "+\n";
+    return line;
+}
+
+// Pad each cell to width + 2 characters: two spaces of margin, then the aligned text.
+void IncrementalTable::append_line(std::string& buffer, const std::vector<std::string>& cells) const
+{
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        std::size_t padding = widths[i] + 2 - display_width(cells[i]);
+        buffer += '|';
+        if (alignment == Alignment::right) buffer.append(padding, ' ');
+        buffer += cells[i];
+        if (alignment == Alignment::left) buffer.append(padding, ' ');
+    }
+    buffer += "|\n";
+}
+
+void IncrementalTable::append_header(std::string& buffer, const std::string& div_line) const
+{
+    buffer += div_line;
+    append_line(buffer, headers);
+    buffer += div_line;
+}
+
+void IncrementalTable::refresh()
+{
+    const std::string div_line = make_div_line();
+    std::string buffer;
+
+    if (widths_changed) {
+        append_header(buffer, div_line);
+        widths_changed = false;
+    }
+
+    // Updated rows first, in table order, then the new ones.
+    std::sort(dirty_rows.begin(), dirty_rows.end());
+    for (auto it = dirty_rows.begin(); it != dirty_rows.end(); ++it) {
+        append_line(buffer, rows[*it]);
+        buffer += div_line;
+        dirty[*it] = 0;
+    }
+    dirty_rows.clear();
+
+    for (; printed_rows < rows.size(); ++printed_rows) {
+        append_line(buffer, rows[printed_rows]);
+        buffer += div_line;
+    }
+
+    os.write(buffer.data(), buffer.size());
+    os.flush();
+}
+
+void IncrementalTable::display_table(std::ostream& out) const
+{
+    const std::string div_line = make_div_line();
+    std::string buffer;
+    append_header(buffer, div_line);
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        append_line(buffer, *it);
+        buffer += div_line;
+    }
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+This file defines the MappedFile class, a read-only memory mapping of a whole file.
+The mapping is released by the destructor. POSIX only (mmap).
+*/
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Class name: MappedFile
+--------------------
+Description: Maps a file read-only into memory so its bytes can be used in place.
+The object can be moved but not copied. An empty file gives data() == nullptr and size() == 0.
+----------------------------------------
+Methods:
+- MappedFile(const std::string& filename)
+    Open and map the file. Throws std::runtime_error on failure.
+- data(), size()
+    Getters for the mapped bytes.
+*/
+class MappedFile
+{
+private:
+    const char* bytes = nullptr;
+    std::size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& m) : bytes(m.bytes), length(m.length) { m.bytes = nullptr; m.length = 0; }
+    MappedFile& operator=(MappedFile&& m);
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+};
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + filename);
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Could not read the size of " + filename);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+
+    if (length > 0) {
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Could not map " + filename);
+        }
+        bytes = static_cast<const char*>(address);
+        // The whole file is normally read front to back.
+        ::madvise(address, length, MADV_SEQUENTIAL);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes != nullptr) {
+        ::munmap(const_cast<char*>(bytes), length);
+    }
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& m)
+{
+    std::swap(bytes, m.bytes);
+    std::swap(length, m.length);
+    return *this;
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+This file defines the SchemaTable class template, a table whose column types are template
+parameters. Rows are tuples of native values, so a row with the wrong number or type of cells
+does not compile, and the column count is a constant the compiler can unroll loops over.
+*/
+
+#ifndef SCHEMA_TABLE_HPP
+#define SCHEMA_TABLE_HPP
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include "TableStream.hpp"
+#include "DisplayWidth.hpp"
+
+// Longest text of a number written by a CellFormatter.
+const std::size_t max_cell_number_length = 64;
+
+/*
+CellFormatter<T> turns a cell of type T into text. format(value, scratch) returns a view of the
+text; numbers are written into scratch, which holds max_cell_number_length characters.
+There is no general version: a column type without a specialization is a compile error, and a
+program can specialize CellFormatter for its own types.
+*/
+template <typename T, typename Enable = void>
+struct CellFormatter;
+
+// Integers, written in full.
+template <typename T>
+struct CellFormatter<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    static std::string_view format(T value, char* scratch)
+    {
+        std::to_chars_result result = std::to_chars(scratch, scratch + max_cell_number_length, value);
+        return std::string_view(scratch, result.ptr - scratch);
+    }
+};
+
+// Floating point numbers, with 6 significant digits like to_string_format().
+template <typename T>
+struct CellFormatter<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static std::string_view format(T value, char* scratch)
+    {
+        std::to_chars_result result = std::to_chars(scratch, scratch + max_cell_number_length, value,
+                                                    std::chars_format::general, 6);
+        return std::string_view(scratch, result.ptr - scratch);
+    }
+};
+
+template <>
+struct CellFormatter<bool>
+{
+    static std::string_view format(bool value, char*) { return value ? "true" : "false"; }
+};
+
+template <>
+struct CellFormatter<std::string>
+{
+    static std::string_view format(const std::string& value, char*) { return value; }
+};
+
+template <>
+struct CellFormatter<std::string_view>
+{
+    static std::string_view format(std::string_view value, char*) { return value; }
+};
+
+template <>
+struct CellFormatter<const char*>
+{
+    static std::string_view format(const char* value, char*) { return value; }
+};
+
+/*
+Class name: SchemaTable
+--------------------
+Description: A table with one column per template parameter, printed in the same bordered format
+as Table. Each row is stored as a std::tuple<Cols...>, and each column is formatted by
+CellFormatter<Col>. The widths of the columns are kept in a std::array and updated as rows are
+appended, like Table does; the cells of a row are visited by fold expressions over the column
+indices, so there is no loop over columns at run time.
+----------------------------------------
+Attributes:
+- headers: (std::array of strings) one header per column.
+- alignments: (std::array of Alignment) alignment of each column, right by default.
+- rows: (vector of std::tuple<Cols...>) the rows.
+- widths: (std::array of size_t) width of each column, the longest formatted cell or header.
+----------------------------------------
+Methods:
+- SchemaTable(Headers&&... headers)
+    One header per column; another number of headers does not compile.
+- append_row(Cols... cells), append_tuple(Row row)
+    Add a row.
+- reserve_rows(std::size_t n)
+    Reserve space for n rows.
+- set_alignment(std::size_t column, Alignment alignment)
+    Change how a column is printed. Throws std::out_of_range for a column that does not exist.
+- get<I>(std::size_t row)
+    The cell of column I in a row.
+- row_count(), get_headers(), get_rows(), get_widths()
+    Getters.
+- display_table(std::ostream& os)
+    Print the table.
+*/
+template <typename... Cols>
+class SchemaTable
+{
+public:
+    static constexpr std::size_t column_count = sizeof...(Cols);
+    typedef std::tuple<Cols...> Row;
+
+    static_assert(column_count > 0, "A SchemaTable needs at least one column");
+
+private:
+    std::array<std::string, column_count> headers;
+    std::array<Alignment, column_count> alignments;
+    std::vector<Row> rows;
+    std::array<std::size_t, column_count> widths;
+
+    typedef std::make_index_sequence<column_count> Columns;
+
+    template <std::size_t... I> void update_widths(const Row& row, std::index_sequence<I...>);
+    template <std::size_t... I> void append_line(std::string& buffer, const Row& row, std::index_sequence<I...>) const;
+    void append_cell_text(std::string& buffer, std::string_view text, std::size_t column) const;
+    std::string make_div_line() const;
+
+public:
+    // Only strings, so a single column table is still copied by its copy constructor.
+    template <typename... Headers,
+              typename = std::enable_if_t<(std::is_convertible_v<Headers, std::string_view> && ...)>>
+    SchemaTable(Headers&&... headers_in);
+
+    void append_row(Cols... cells) { append_tuple(Row(std::move(cells)...)); }
+    void append_tuple(Row row);
+    void reserve_rows(std::size_t n) { rows.reserve(n); }
+    void set_alignment(std::size_t column, Alignment alignment) { alignments.at(column) = alignment; }
+
+    template <std::size_t I> const std::tuple_element_t<I, Row>& get(std::size_t row) const
+    {
+        return std::get<I>(rows[row]);
+    }
+    std::size_t row_count() const { return rows.size(); }
+    const std::array<std::string, column_count>& get_headers() const { return headers; }
+    const std::vector<Row>& get_rows() const { return rows; }
+    const std::array<std::size_t, column_count>& get_widths() const { return widths; }
+
+    void display_table(std::ostream& os = std::cout) const;
+};
+
+template <typename... Cols>
+template <typename... Headers, typename>
+SchemaTable<Cols...>::SchemaTable(Headers&&... headers_in) :
+    headers{std::string(std::forward<Headers>(headers_in))...}
+{
+    static_assert(sizeof...(Headers) == column_count, "A SchemaTable needs one header per column");
+    alignments.fill(Alignment::right);
+    for (std::size_t i = 0; i < column_count; ++i) {
+        widths[i] = display_width(headers[i]);
+    }
+}
+
+template <typename... Cols>
+template <std::size_t... I>
+void SchemaTable<Cols...>::update_widths(const Row& row, std::index_sequence<I...>)
+{
+    char scratch[max_cell_number_length];
+    ((widths[I] = std::max(widths[I], display_width(CellFormatter<Cols>::format(std::get<I>(row), scratch)))), ...);
+}
+
+template <typename... Cols>
+void SchemaTable<Cols...>::append_tuple(Row row)
+{
+    update_widths(row, Columns{});
+    rows.push_back(std::move(row));
+}
+
+// Pad the text to width + 2 characters: two spaces of margin, then the aligned text.
+template <typename... Cols>
+void SchemaTable<Cols...>::append_cell_text(std::string& buffer, std::string_view text, std::size_t column) const
+{
+    std::size_t padding = widths[column] + 2 - display_width(text);
+    buffer += '|';
+    if (alignments[column] == Alignment::right) buffer.append(padding, ' ');
+    buffer.append(text.data(), text.size());
+    if (alignments[column] == Alignment::left) buffer.append(padding, ' ');
+}
+
+template <typename... Cols>
+template <std::size_t... I>
+void SchemaTable<Cols...>::append_line(std::string& buffer, const Row& row, std::index_sequence<I...>) const
+{
+    char scratch[max_cell_number_length];
+    (append_cell_text(buffer, CellFormatter<Cols>::format(std::get<I>(row), scratch), I), ...);
+    buffer += "|\n";
+}
+
+template <typename... Cols>
+std::string SchemaTable<Cols...>::make_div_line() const
+{
+    std::string line;
+    for (std::size_t i = 0; i < column_count; ++i) {
+        line += '+';
+        line.append(widths[i] + 2, '-');
+    }
+    line += "+\n";
+    return line;
+}
+
+// The table is assembled in a buffer that is handed to the stream every 64 KiB, like Table::render().
+template <typename... Cols>
+void SchemaTable<Cols...>::display_table(std::ostream& os) const
+{
+    const std::size_t block_size = 1 << 16;
+    const std::string div_line = make_div_line();
+    std::string buffer;
+    buffer.reserve(block_size + 1024);
+
+    // print headers
+    buffer += div_line;
+    for (std::size_t i = 0; i < column_count; ++i) {
+        append_cell_text(buffer, headers[i], i);
+    }
+    buffer += "|\n";
+    buffer += div_line;
+
+    // print rows
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        append_line(buffer, *it, Columns{});
+        buffer += div_line;
+        if (buffer.size() >= block_size) {
+            os.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    os.write(buffer.data(), buffer.size());
+    os.flush();
+}
+
+#endif
@@ -11,6 +11,27 @@ Author: Zhiyu Liu, University of Manchester, 2023.3.3
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <sstream>
+#include <cstddef>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+#include "DisplayWidth.hpp"
+#include <utility>
+#include <algorithm>
+#include "Parallel.hpp"
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+// A template function to convert numbers to strings and keep the initial format.
+template <typename T>
+std::string to_string_format(const T num)
+{
+    std::ostringstream oss;
+    oss << num;
+    return oss.str();
+}
 
 /*
 Class name: Table
@@ -23,61 +44,98 @@ Attributes:
 - headers: a vector of strings representing the headers of the table.
 - rows: a vector that consists of the rows of the table, each row is a vector of strings.
         (excluding the header row)
-- columns: a vector that consists of the columns of the table, each column is a vector of strings.
-- max_length_each_col: a vector of integers representing the maximum length in each column.
+- max_length_each_col: a vector of integers representing the maximum length in each column,
+  measured in terminal columns with display_width() so that UTF-8 text lines up.
 ----------------------------------------
 Methods:
 - Table()
     Default constructor.
-- Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in)
+- Table(std::vector<std::string> headers_in)
+    Constructor for a table without rows. Rows are added with append_row()/emplace_row().
+- Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in, unsigned threads)
     Constructor that uses rows to construct the table
     The first argument is a vector of strings that takes in the table headers.
     The second argument is a 2-dimensional vector of strings that takes in the table rows.
-    The constructor then gets the columns and maximum lengths in each column using the input headers/rows.
+    The arguments are moved into the table, pass them with std::move to avoid any copy.
+    The constructor computes the maximum length in each column directly from the headers/rows.
+    With threads > 1 (0 = every hardware thread) the rows are measured in chunks on separate threads.
+- Table(std::vector<std::string> headers_in, const std::vector<std::vector<T>>& rows_in, unsigned threads)
+    Same as above for rows of numbers, converted with to_string_format() (in parallel with threads > 1).
 - ~Table() {}
     Destructor.
 - get_headers(), get_rows(), get_max_length_each_col()
-    Getter methods to protect the object information.
+    Getter methods to protect the object information. They return const references.
+- rows_span()
+    The rows as a std::span (C++20 only).
+- reserve_rows(std::size_t n)
+    Reserve space for n rows so that appending does not reallocate.
+- append_row(std::vector<std::string> row), emplace_row(Cells&&... cells)
+    Add a row at the end, either moved in or with its cells constructed in place.
+    The column widths are updated. Throws std::out_of_range if the number of cells is wrong.
 - get_columns()
-    A method that returns the columns of the table.
+    A method that returns the columns of the table. They are built on demand and not stored.
     return type: 2-dimensional vector of strings.
-- draw_div_line()
+- draw_div_line(std::ostream& os)
     A method that draws a dividing line between adjacent rows.
-- display_table()
-    A method that prints the formatted table.
+- display_table(std::ostream& os, unsigned threads)
+    A method that prints the formatted table to any output stream (std::cout by default).
+    Whole lines are assembled in a buffer and written in blocks of 64 KiB,
+    the stream is flushed once at the end.
+    With threads > 1 batches of rows are rendered in chunks on separate threads and written
+    in order; the output is byte for byte the same.
+- display_table(int fd, unsigned threads)
+    Same as above, but the blocks are written straight to a file descriptor.
+    Flush std::cout first if it is mixed with output to descriptor 1.
 */
 class Table
 {
 private:
     std::vector<std::string> headers;              
     std::vector<std::vector<std::string>> rows;    
-    std::vector<std::vector<std::string>> columns;  
     std::vector<unsigned> max_length_each_col;
+
+    void check_row(const std::vector<std::string>& row) const;
+    void measure_rows(unsigned threads);
 public:
     Table() = default;
-    Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in);
-    template <typename T> Table(std::vector<std::string> headers_in, std::vector<std::vector<T>> row_in);
+    Table(std::vector<std::string> headers_in);
+    Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in, unsigned threads = 1);
+    template <typename T> Table(std::vector<std::string> headers_in, const std::vector<std::vector<T>>& rows_in,
+                                unsigned threads = 1);
 
     ~Table() {}
 
-    std::vector<std::string> get_headers() const {return headers;}
-    std::vector<std::vector<std::string>> get_rows() const {return rows;}
-    std::vector<unsigned> get_max_length_each_col() const {return max_length_each_col;}
+    const std::vector<std::string>& get_headers() const {return headers;}
+    const std::vector<std::vector<std::string>>& get_rows() const {return rows;}
+    const std::vector<unsigned>& get_max_length_each_col() const {return max_length_each_col;}
+#if __cplusplus >= 202002L
+    std::span<const std::vector<std::string>> rows_span() const {return rows;}
+#endif
+
+    void reserve_rows(std::size_t n) {rows.reserve(n);}
+    void append_row(std::vector<std::string> row);
+    template <typename... Cells> void emplace_row(Cells&&... cells);
 
     std::vector<std::vector<std::string>> get_columns() const;
-    void draw_div_line() const;
-    void display_table() const;
+    void draw_div_line(std::ostream& os = std::cout) const;
+    void display_table(std::ostream& os = std::cout, unsigned threads = 1) const;
+    void display_table(int fd, unsigned threads = 1) const;
+
+private:
+    std::string make_div_line() const;
+    void append_rows(std::string& buffer, const std::string& div_line, std::size_t begin, std::size_t end) const;
+    template <typename Sink> void render(Sink write_block, unsigned threads) const;
 };
 
 // Get the maximum length of each column and stores them in a vector of integers.
-std::vector<unsigned> get_max_length(std::vector<std::vector<std::string>> columns)
+std::vector<unsigned> get_max_length(const std::vector<std::vector<std::string>>& columns)
 {
     std::vector<unsigned> vec_max_length;
 
     for (auto it_col = columns.begin(); it_col != columns.end(); ++it_col) {
         unsigned max_length = 0;
         for (auto it_cell = it_col->begin(); it_cell != it_col->end(); ++it_cell) {
-            max_length = std::max(max_length, static_cast<unsigned>(it_cell->length()));
+            max_length = std::max(max_length, static_cast<unsigned>(display_width(*it_cell)));
         }
         vec_max_length.push_back(max_length);
     }
@@ -85,34 +143,109 @@ std::vector<unsigned> get_max_length(std::vector<std::vector<std::string>> colum
     return vec_max_length;
 }
 
+// Widen the maximum lengths to fit one more row.
+void update_max_length(std::vector<unsigned>& max_length_each_col, const std::vector<std::string>& row)
+{
+    for (std::size_t i = 0; i < row.size(); ++i) {
+        max_length_each_col[i] = std::max(max_length_each_col[i], static_cast<unsigned>(display_width(row[i])));
+    }
+}
+
+// Constructor without rows, the widths start at the lengths of the headers.
+Table::Table(std::vector<std::string> headers_in) : headers(std::move(headers_in))
+{
+    max_length_each_col.reserve(headers.size());
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        max_length_each_col.push_back(static_cast<unsigned>(display_width(*it)));
+    }
+}
+
 // Parameterized constructor.
-Table::Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in) :
-    headers(headers_in), rows(rows_in) 
+Table::Table(std::vector<std::string> headers_in, std::vector<std::vector<std::string>> rows_in, unsigned threads) :
+    Table(std::move(headers_in))
 {
-    columns = get_columns();
-    max_length_each_col = get_max_length(columns);
+    rows = std::move(rows_in);
+    measure_rows(threads);
 }
 
+template <typename T> Table::Table(std::vector<std::string> headers_in, const std::vector<std::vector<T>>& rows_in,
+                                   unsigned threads) :
+    Table(std::move(headers_in))
+{
+    rows.resize(rows_in.size());
+    // Every row is written by one thread only, so the chunks need no locking.
+    parallel_for(rows_in.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            std::vector<std::string>& r = rows[i];
+            r.reserve(rows_in[i].size());
+            for (auto it = rows_in[i].begin(); it != rows_in[i].end(); ++it) {
+                r.push_back(to_string_format(*it));
+            }
+        }
+    });
+    measure_rows(threads);
+}
 
-template <typename T> Table::Table(std::vector<std::string> headers_in, std::vector<std::vector<T>> rows_in) :
-    headers(headers_in)
+/*
+Check every row and widen the columns to fit them. Each chunk of rows gets its own
+widths, which are combined with a max-reduction at the end.
+*/
+void Table::measure_rows(unsigned threads)
 {
-    std::vector<std::vector<std::string>> rs{};
-    std::vector<std::string> r{};
+    if (threads == 0) threads = default_thread_count();
+    std::size_t n_chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, rows.size()));
+    std::vector<std::vector<unsigned>> chunk_widths(n_chunks, max_length_each_col);
+    std::vector<std::size_t> bad_rows(n_chunks, rows.size());
 
-    for (auto it1 = rows_in.begin(); it1 != rows_in.end(); ++it1)
-    {
-        for (auto it2 = it1->begin(); it2 != it1->end(); ++it2)
-        {
-            r.push_back(to_string_format(*it2));
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            std::size_t begin = rows.size() * k / n_chunks, end = rows.size() * (k + 1) / n_chunks;
+            for (std::size_t i = begin; i < end; ++i) {
+                if (rows[i].size() != headers.size()) {
+                    bad_rows[k] = i;
+                    break;
+                }
+                update_max_length(chunk_widths[k], rows[i]);
+            }
         }
-        rs.push_back(r);
+    });
+
+    for (std::size_t k = 0; k < n_chunks; ++k) {
+        // Report the first bad row, as a serial pass would.
+        if (bad_rows[k] != rows.size()) check_row(rows[bad_rows[k]]);
+        for (std::size_t i = 0; i < max_length_each_col.size(); ++i) {
+            max_length_each_col[i] = std::max(max_length_each_col[i], chunk_widths[k][i]);
+        }
+    }
+}
+
+void Table::check_row(const std::vector<std::string>& row) const
+{
+    if (row.size() != headers.size()) {
+        throw std::out_of_range("Row has " + std::to_string(row.size()) + " cells, expected " +
+                                std::to_string(headers.size()));
     }
-    rows = rs;
-    columns = get_columns();
-    max_length_each_col = get_max_length(columns);
 }
 
+void Table::append_row(std::vector<std::string> row)
+{
+    check_row(row);
+    update_max_length(max_length_each_col, row);
+    rows.push_back(std::move(row));
+}
+
+template <typename... Cells>
+void Table::emplace_row(Cells&&... cells)
+{
+    if (sizeof...(Cells) != headers.size()) {
+        throw std::out_of_range("Row has " + std::to_string(sizeof...(Cells)) + " cells, expected " +
+                                std::to_string(headers.size()));
+    }
+    std::vector<std::string>& row = rows.emplace_back();
+    row.reserve(sizeof...(Cells));
+    (row.emplace_back(std::forward<Cells>(cells)), ...);
+    update_max_length(max_length_each_col, row);
+}
 
 std::vector<std::vector<std::string>> Table::get_columns() const
 {
@@ -137,51 +270,122 @@ std::vector<std::vector<std::string>> Table::get_columns() const
     return columns;
 }
 
-void Table::draw_div_line() const
+// Build the dividing line once, eg: "+-----+-------+\n".
+std::string Table::make_div_line() const
 {
-    int i = 0;
-    for (auto it = headers.begin(); it != headers.end(); ++it) {
+    std::string line;
+    for (std::size_t i = 0; i < headers.size(); ++i) {
         // The length of each cell is given by the maximum length in its column + 2.
-        std::cout << "+" << std::setfill('-') << std::setw(max_length_each_col.at(i) + 2) << "";
-        ++i;
+        line += '+';
+        line.append(max_length_each_col.at(i) + 2, '-');
     }
-    std::cout << "+" << std::endl;
+    line += "+\n";
+    return line;
 }
 
-void Table::display_table() const
+void Table::draw_div_line(std::ostream& os) const
 {
-    draw_div_line();
+    std::string line = make_div_line();
+    os.write(line.data(), line.size());
+}
+
+// Append one row of cells to the buffer, each cell padded to the width of its column + 2.
+void append_table_line(std::string& buffer, const std::vector<std::string>& cells,
+                       const std::vector<unsigned>& widths)
+{
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        const std::string& cell = cells[i];
+        std::size_t width = widths.at(i) + 2;
+        std::size_t cell_width = display_width(cell);
+        std::size_t padding = width > cell_width ? width - cell_width : 0;
+        buffer += '|';
+        buffer.append(padding, ' ');
+        buffer += cell;
+    }
+    buffer += "|\n";
+}
+
+void Table::append_rows(std::string& buffer, const std::string& div_line, std::size_t begin, std::size_t end) const
+{
+    for (std::size_t i = begin; i < end; ++i) {
+        append_table_line(buffer, rows[i], max_length_each_col);
+        buffer += div_line;
+    }
+}
+
+/*
+Assemble the table line by line in a buffer and hand it to write_block(data, size)
+every time it grows past 64 KiB, so a large table is written in a few big calls.
+With several threads, batches of rows are split into one chunk per thread; the chunks are
+rendered into their own buffers at the same time and handed over in order.
+*/
+template <typename Sink>
+void Table::render(Sink write_block, unsigned threads) const
+{
+    const std::size_t block_size = 1 << 16;
+    const std::string div_line = make_div_line();
+    std::string buffer;
+    buffer.reserve(block_size + 1024);
 
     // print headers
-    int i = 0;  // unsigned integer to track the number of columns
-    for (auto it = headers.begin(); it != headers.end(); ++it) {
-        std::cout << "|" << std::setfill(' ') << std::setw(max_length_each_col.at(i) + 2);
-        std::cout << std::right << *it;
-        ++i;
+    buffer += div_line;
+    append_table_line(buffer, headers, max_length_each_col);
+    buffer += div_line;
+
+    if (threads == 0) threads = default_thread_count();
+    if (threads > 1) {
+        write_block(buffer.data(), buffer.size());
+
+        // Enough rows per chunk to be worth a thread, few enough to keep the buffers small.
+        const std::size_t chunk_rows = 16384;
+        std::vector<std::string> parts(threads);
+        for (std::size_t batch = 0; batch < rows.size(); batch += threads * chunk_rows) {
+            std::size_t batch_end = std::min(rows.size(), batch + threads * chunk_rows);
+            std::size_t n_chunks = (batch_end - batch + chunk_rows - 1) / chunk_rows;
+            parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+                for (std::size_t k = first; k < last; ++k) {
+                    parts[k].clear();
+                    append_rows(parts[k], div_line, batch + k * chunk_rows,
+                                std::min(batch_end, batch + (k + 1) * chunk_rows));
+                }
+            });
+            for (std::size_t k = 0; k < n_chunks; ++k) {
+                write_block(parts[k].data(), parts[k].size());
+            }
+        }
+        return;
     }
-    std::cout << "|" << std::endl;
 
-    draw_div_line();
-    
     // print rows
-    for (auto it1 = rows.begin(); it1 != rows.end(); ++it1) {
-        i = 0;
-        for (auto it2 = it1->begin(); it2 != it1->end(); ++it2) {
-            std::cout << "|" << std::setfill(' ') << std::setw(max_length_each_col.at(i) + 2);
-            std::cout << std::right << *it2;
-            ++i;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        append_rows(buffer, div_line, i, i + 1);
+        if (buffer.size() >= block_size) {
+            write_block(buffer.data(), buffer.size());
+            buffer.clear();
         }
-        std::cout << "|" << std::endl;
-        draw_div_line();
     }
+    write_block(buffer.data(), buffer.size());
 }
 
-template <typename T>
-std::string to_string_format(const T num)
+void Table::display_table(std::ostream& os, unsigned threads) const
 {
-    std::ostringstream oss;
-    oss << num;
-    return oss.str();
+    render([&os](const char* data, std::size_t size) { os.write(data, size); }, threads);
+    os.flush();
+}
+
+void Table::display_table(int fd, unsigned threads) const
+{
+    render([fd](const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Could not write the table");
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }, threads);
 }
 
 #endif
\ No newline at end of file
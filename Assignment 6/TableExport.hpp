@@ -0,0 +1,398 @@
+/*
+This file defines writers that export a table in machine readable formats:
+CSV, TSV, Markdown and JSON Lines. None of them needs the column widths, so rows
+are written as they come, through a buffer that is handed to the stream in large blocks.
+*/
+
+#ifndef TABLE_EXPORT_HPP
+#define TABLE_EXPORT_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <stdexcept>
+#include "Table.hpp"
+#include "ColumnTable.hpp"
+
+/*
+Class name: TableWriter
+--------------------
+Description:
+The `TableWriter` class is an abstract base class for the export formats.
+It owns the output buffer and turns every row source into a vector of std::string_view cells,
+so derived classes only implement how the header and a row are appended to the buffer.
+
+The derived classes `CsvWriter`, `TsvWriter`, `MarkdownWriter` and `JsonLinesWriter`
+implement the formats. Output is written to the stream every 64 KiB, by finish() and by the destructor.
+
+Public Methods:
+- virtual ~TableWriter()
+    Writes what is left in the buffer.
+- TableWriter(std::ostream& os_in)
+    A constructor that takes the destination stream.
+- write_header(const std::vector<std::string>& headers)
+    Write the header. Must be called once, before the first row.
+- write_row(const Row& row)
+    Write one row. Row can be any container of std::string or std::string_view.
+- write_table(const Table& table), write_table(const ColumnTable& table)
+    Write the header and every row of a table. Numbers of a ColumnTable are formatted like
+    display_table() prints them and are marked as numbers for the formats that care (JSON).
+- finish()
+    Hand the buffered output to the stream.
+*/
+class TableWriter
+{
+protected:
+    std::ostream& os;
+    std::string buffer;
+    std::vector<std::string> headers;
+    std::vector<bool> numeric;          // Columns whose cells are numbers, empty means all text.
+
+    static const std::size_t block_size = 1 << 16;
+
+    virtual void append_header() = 0;
+    virtual void append_row(const std::vector<std::string_view>& cells) = 0;
+
+    bool is_numeric(std::size_t column) const { return column < numeric.size() && numeric[column]; }
+
+private:
+    std::vector<std::string_view> cells;    // Reused between rows.
+
+    void write_cells();
+
+public:
+    virtual ~TableWriter() { finish(); }
+    TableWriter(std::ostream& os_in) : os{os_in} { buffer.reserve(block_size + 1024); }
+
+    void write_header(const std::vector<std::string>& headers_in);
+    template <typename Row> void write_row(const Row& row);
+    void write_table(const Table& table);
+    void write_table(const ColumnTable& table);
+    void finish();
+};
+
+void TableWriter::write_header(const std::vector<std::string>& headers_in)
+{
+    headers = headers_in;
+    append_header();
+}
+
+void TableWriter::write_cells()
+{
+    if (cells.size() != headers.size()) {
+        throw std::invalid_argument("Row has " + std::to_string(cells.size()) + " cells, expected " +
+                                    std::to_string(headers.size()));
+    }
+    append_row(cells);
+    if (buffer.size() >= block_size) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+template <typename Row>
+void TableWriter::write_row(const Row& row)
+{
+    cells.clear();
+    for (auto it = row.begin(); it != row.end(); ++it) {
+        cells.emplace_back(*it);
+    }
+    write_cells();
+}
+
+void TableWriter::write_table(const Table& table)
+{
+    numeric.clear();
+    write_header(table.get_headers());
+    const std::vector<std::vector<std::string>>& rows = table.get_rows();
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        write_row(*it);
+    }
+    finish();
+}
+
+void TableWriter::write_table(const ColumnTable& table)
+{
+    std::size_t n_columns = table.column_count();
+    std::vector<std::string> table_headers;
+    numeric.assign(n_columns, false);
+    for (std::size_t i = 0; i < n_columns; ++i) {
+        table_headers.push_back(table.get_header(i));
+        numeric[i] = table.get_type(i) != ColumnType::text;
+    }
+    write_header(table_headers);
+
+    // One scratch slot per column, the views stay valid until the row is written.
+    std::vector<char> scratch(n_columns * ColumnTable::max_number_length);
+    for (std::size_t row = 0; row < table.row_count(); ++row) {
+        cells.clear();
+        for (std::size_t i = 0; i < n_columns; ++i) {
+            cells.push_back(table.cell_text(row, i, scratch.data() + i * ColumnTable::max_number_length));
+        }
+        write_cells();
+    }
+    finish();
+}
+
+void TableWriter::finish()
+{
+    if (!buffer.empty()) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    os.flush();
+}
+
+/*
+Class name: CsvWriter
+--------------------
+Description: Comma separated values following RFC 4180. A field is quoted only when it contains
+the delimiter, a double quote, CR or LF; quotes inside it are doubled. Lines end with CRLF
+unless another line ending is given.
+*/
+class CsvWriter : public TableWriter
+{
+private:
+    char delimiter;
+    std::string line_ending;
+
+    void append_field(std::string_view field);
+    void append_fields(const std::vector<std::string_view>& fields);
+
+protected:
+    void append_header();
+    void append_row(const std::vector<std::string_view>& cells) { append_fields(cells); }
+
+public:
+    CsvWriter(std::ostream& os_in, char delimiter_in = ',', std::string line_ending_in = "\r\n") :
+        TableWriter{os_in}, delimiter{delimiter_in}, line_ending{std::move(line_ending_in)} {}
+    ~CsvWriter() {}
+};
+
+void CsvWriter::append_field(std::string_view field)
+{
+    const char specials[] = {delimiter, '"', '\r', '\n'};
+    if (field.find_first_of(std::string_view(specials, 4)) == std::string_view::npos) {
+        buffer.append(field.data(), field.size());
+        return;
+    }
+    buffer += '"';
+    std::size_t start = 0, quote;
+    while ((quote = field.find('"', start)) != std::string_view::npos) {
+        buffer.append(field.data() + start, quote + 1 - start);
+        buffer += '"';
+        start = quote + 1;
+    }
+    buffer.append(field.data() + start, field.size() - start);
+    buffer += '"';
+}
+
+void CsvWriter::append_fields(const std::vector<std::string_view>& fields)
+{
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) buffer += delimiter;
+        append_field(fields[i]);
+    }
+    buffer += line_ending;
+}
+
+void CsvWriter::append_header()
+{
+    append_fields(std::vector<std::string_view>(headers.begin(), headers.end()));
+}
+
+/*
+Class name: TsvWriter
+--------------------
+Description: Tab separated values, one row per line. TSV has no quoting, so tabs, newlines and
+backslashes inside a field are written as the escapes \t, \n, \r and \\.
+*/
+class TsvWriter : public TableWriter
+{
+private:
+    void append_field(std::string_view field);
+    void append_fields(const std::vector<std::string_view>& fields);
+
+protected:
+    void append_header() { append_fields(std::vector<std::string_view>(headers.begin(), headers.end())); }
+    void append_row(const std::vector<std::string_view>& cells) { append_fields(cells); }
+
+public:
+    TsvWriter(std::ostream& os_in) : TableWriter{os_in} {}
+    ~TsvWriter() {}
+};
+
+void TsvWriter::append_field(std::string_view field)
+{
+    std::size_t start = 0, special;
+    while ((special = field.find_first_of("\t\n\r\\", start)) != std::string_view::npos) {
+        buffer.append(field.data() + start, special - start);
+        buffer += '\\';
+        switch (field[special]) {
+        case '\t': buffer += 't'; break;
+        case '\n': buffer += 'n'; break;
+        case '\r': buffer += 'r'; break;
+        default: buffer += '\\'; break;
+        }
+        start = special + 1;
+    }
+    buffer.append(field.data() + start, field.size() - start);
+}
+
+void TsvWriter::append_fields(const std::vector<std::string_view>& fields)
+{
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) buffer += '\t';
+        append_field(fields[i]);
+    }
+    buffer += '\n';
+}
+
+/*
+Class name: MarkdownWriter
+--------------------
+Description: A GitHub flavoured Markdown table. The delimiter row carries the alignment
+(right by default, like Table). '|' inside a cell is escaped and line breaks become <br>.
+Cells are not padded, Markdown renderers align the columns themselves.
+*/
+class MarkdownWriter : public TableWriter
+{
+private:
+    Alignment alignment;
+
+    void append_field(std::string_view field);
+    void append_fields(const std::vector<std::string_view>& fields);
+
+protected:
+    void append_header();
+    void append_row(const std::vector<std::string_view>& cells) { append_fields(cells); }
+
+public:
+    MarkdownWriter(std::ostream& os_in, Alignment alignment_in = Alignment::right) :
+        TableWriter{os_in}, alignment{alignment_in} {}
+    ~MarkdownWriter() {}
+};
+
+void MarkdownWriter::append_field(std::string_view field)
+{
+    std::size_t start = 0, special;
+    while ((special = field.find_first_of("|\r\n", start)) != std::string_view::npos) {
+        buffer.append(field.data() + start, special - start);
+        if (field[special] == '|') {
+            buffer += "\\|";
+        } else {
+            // A CRLF pair is a single line break.
+            if (field[special] == '\r' && special + 1 < field.size() && field[special + 1] == '\n') ++special;
+            buffer += "<br>";
+        }
+        start = special + 1;
+    }
+    buffer.append(field.data() + start, field.size() - start);
+}
+
+void MarkdownWriter::append_fields(const std::vector<std::string_view>& fields)
+{
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        buffer += "| ";
+        append_field(fields[i]);
+        buffer += ' ';
+    }
+    buffer += "|\n";
+}
+
+void MarkdownWriter::append_header()
+{
+    append_fields(std::vector<std::string_view>(headers.begin(), headers.end()));
+    for (std::size_t i = 0; i < headers.size(); ++i) {
+        buffer += alignment == Alignment::right ? "| ---: " : "| :--- ";
+    }
+    buffer += "|\n";
+}
+
+/*
+Class name: JsonLinesWriter
+--------------------
+Description: One JSON object per row, keyed by the headers, one object per line (JSON Lines).
+Cells are JSON strings, except the numeric columns of a ColumnTable, which are written as numbers
+(null for nan and infinities, which JSON cannot represent). Nothing is written for the header.
+*/
+class JsonLinesWriter : public TableWriter
+{
+private:
+    std::vector<std::string> keys;      // Headers already escaped and quoted, followed by ':'.
+
+    void append_string(std::string_view text);
+
+protected:
+    void append_header();
+    void append_row(const std::vector<std::string_view>& cells);
+
+public:
+    JsonLinesWriter(std::ostream& os_in) : TableWriter{os_in} {}
+    ~JsonLinesWriter() {}
+};
+
+void JsonLinesWriter::append_string(std::string_view text)
+{
+    static const char hex[] = "0123456789abcdef";
+    buffer += '"';
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        buffer.append(text.data() + start, i - start);
+        start = i + 1;
+        switch (c) {
+        case '"': buffer += "\\\""; break;
+        case '\\': buffer += "\\\\"; break;
+        case '\n': buffer += "\\n"; break;
+        case '\r': buffer += "\\r"; break;
+        case '\t': buffer += "\\t"; break;
+        default:
+            buffer += "\\u00";
+            buffer += hex[c >> 4];
+            buffer += hex[c & 0xf];
+            break;
+        }
+    }
+    buffer.append(text.data() + start, text.size() - start);
+    buffer += '"';
+}
+
+void JsonLinesWriter::append_header()
+{
+    // The keys are the same on every line, so they are escaped once.
+    keys.clear();
+    std::string saved;
+    saved.swap(buffer);
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        buffer.clear();
+        append_string(*it);
+        buffer += ':';
+        keys.push_back(buffer);
+    }
+    buffer.swap(saved);
+}
+
+void JsonLinesWriter::append_row(const std::vector<std::string_view>& cells)
+{
+    buffer += '{';
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        if (i > 0) buffer += ',';
+        buffer += keys[i];
+        if (!is_numeric(i)) {
+            append_string(cells[i]);
+        } else if (cells[i].find_first_of("ni") != std::string_view::npos) {
+            // "nan", "inf" and their signed forms.
+            buffer += "null";
+        } else {
+            buffer.append(cells[i].data(), cells[i].size());
+        }
+    }
+    buffer += "}\n";
+}
+
+#endif
@@ -0,0 +1,442 @@
+/*
+This file defines a small query layer over ColumnTable: sorting, filtering, group-by and
+aggregation. Rows are never moved: results are selections, vectors of row indices that
+can be refined by further queries and turned into a new table with ColumnTable::take().
+*/
+
+#ifndef TABLE_QUERY_HPP
+#define TABLE_QUERY_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include "ColumnTable.hpp"
+#include "Parallel.hpp"
+
+enum class SortOrder { ascending, descending };
+
+struct SortKey
+{
+    std::size_t column;
+    SortOrder order = SortOrder::ascending;
+};
+
+// Row indices into a ColumnTable, in the order they should be read.
+typedef std::vector<std::size_t> RowSelection;
+
+// Below this many rows per thread a query runs on the calling thread only.
+const std::size_t min_rows_per_thread = 1 << 16;
+
+RowSelection all_rows(const ColumnTable& table)
+{
+    RowSelection rows(table.row_count());
+    std::iota(rows.begin(), rows.end(), std::size_t{0});
+    return rows;
+}
+
+// Number of chunks worth running for n rows on the given number of threads.
+std::size_t query_chunk_count(std::size_t n, unsigned threads)
+{
+    if (threads == 0) threads = default_thread_count();
+    return std::max<std::size_t>(1, std::min<std::size_t>(threads, n / min_rows_per_thread));
+}
+
+/*
+Sorting
+------------------------------------------------------------
+sort_rows() sorts row indices with std::stable_sort, so rows that compare equal on every key keep
+their order. Each key compares one column; the next key only breaks ties. NaN sorts last in both orders.
+*/
+
+// Three-way comparison of two values of one column, NaN after every number.
+template <typename T>
+int compare_values(const T& a, const T& b)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        bool a_nan = std::isnan(a), b_nan = std::isnan(b);
+        if (a_nan || b_nan) return static_cast<int>(a_nan) - static_cast<int>(b_nan);
+    }
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+RowSelection sort_rows(const ColumnTable& table, const std::vector<SortKey>& keys, RowSelection rows)
+{
+    // The column data of every key, looked up once instead of in every comparison.
+    struct KeyColumn
+    {
+        ColumnType type;
+        const double* reals;
+        const std::int64_t* integers;
+        const std::string* texts;
+        bool descending;
+    };
+    std::vector<KeyColumn> columns;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        if (it->column >= table.column_count()) throw std::out_of_range("No such sort column");
+        KeyColumn key{table.get_type(it->column), nullptr, nullptr, nullptr, it->order == SortOrder::descending};
+        if (key.type == ColumnType::real) key.reals = table.reals(it->column).data();
+        else if (key.type == ColumnType::integer) key.integers = table.integers(it->column).data();
+        else key.texts = table.texts(it->column).data();
+        columns.push_back(key);
+    }
+
+    auto before = [&columns](std::size_t a, std::size_t b) {
+        for (auto it = columns.begin(); it != columns.end(); ++it) {
+            int order = 0;
+            switch (it->type) {
+            case ColumnType::real:
+                order = compare_values(it->reals[a], it->reals[b]);
+                // NaN stays last when the other numbers are reversed.
+                if (it->descending && !std::isnan(it->reals[a]) && !std::isnan(it->reals[b])) order = -order;
+                break;
+            case ColumnType::integer:
+                order = compare_values(it->integers[a], it->integers[b]);
+                if (it->descending) order = -order;
+                break;
+            case ColumnType::text:
+                order = it->texts[a].compare(it->texts[b]);
+                if (it->descending) order = -order;
+                break;
+            }
+            if (order != 0) return order < 0;
+        }
+        return false;
+    };
+    std::stable_sort(rows.begin(), rows.end(), before);
+    return rows;
+}
+
+RowSelection sort_rows(const ColumnTable& table, const std::vector<SortKey>& keys)
+{
+    return sort_rows(table, keys, all_rows(table));
+}
+
+/*
+Filtering
+------------------------------------------------------------
+filter_rows() keeps the rows whose value in a column satisfies a predicate. The predicate takes
+a double, an int64 or a const std::string& depending on the column type. The rows are split into
+chunks that are filtered on separate threads and joined in order, so the result does not depend
+on the number of threads.
+*/
+template <typename T, typename Pred>
+RowSelection select_where(const std::vector<T>& values, Pred& pred, unsigned threads, const RowSelection* within)
+{
+    std::size_t n = within != nullptr ? within->size() : values.size();
+    std::size_t n_chunks = query_chunk_count(n, threads);
+    std::vector<RowSelection> parts(n_chunks);
+
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            std::size_t begin = n * k / n_chunks, end = n * (k + 1) / n_chunks;
+            RowSelection& part = parts[k];
+            part.resize(end - begin);
+            // Always store the row, only advance when it passes: no branch to mispredict.
+            std::size_t count = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                std::size_t row = within != nullptr ? (*within)[i] : i;
+                part[count] = row;
+                count += pred(values[row]) ? 1 : 0;
+            }
+            part.resize(count);
+        }
+    });
+
+    if (n_chunks == 1) return std::move(parts[0]);
+    RowSelection rows;
+    std::size_t total = 0;
+    for (auto it = parts.begin(); it != parts.end(); ++it) total += it->size();
+    rows.reserve(total);
+    for (auto it = parts.begin(); it != parts.end(); ++it) rows.insert(rows.end(), it->begin(), it->end());
+    return rows;
+}
+
+template <typename Pred>
+RowSelection filter_rows(const ColumnTable& table, std::size_t column, Pred pred, unsigned threads = 1,
+                         const RowSelection* within = nullptr)
+{
+    switch (table.get_type(column)) {
+    case ColumnType::real:
+        if constexpr (std::is_invocable_r_v<bool, Pred&, double>) {
+            return select_where(table.reals(column), pred, threads, within);
+        }
+        break;
+    case ColumnType::integer:
+        if constexpr (std::is_invocable_r_v<bool, Pred&, std::int64_t>) {
+            return select_where(table.integers(column), pred, threads, within);
+        }
+        break;
+    case ColumnType::text:
+        if constexpr (std::is_invocable_r_v<bool, Pred&, const std::string&>) {
+            return select_where(table.texts(column), pred, threads, within);
+        }
+        break;
+    }
+    throw std::invalid_argument("The predicate does not take the values of column " + table.get_header(column));
+}
+
+/*
+Aggregation
+------------------------------------------------------------
+An Aggregate holds the count, sum, minimum and maximum of a set of numbers; NaN values are skipped.
+aggregate_column() summarises a numeric column, group_by() one Aggregate per distinct key.
+Both split the rows into chunks, summarise the chunks on separate threads and merge the partial
+results in chunk order. The chunks depend on the number of threads, so sums can differ in their
+last bits between thread counts.
+*/
+struct Aggregate
+{
+    std::size_t count = 0;
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value)
+    {
+        if (std::isnan(value)) return;
+        ++count;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    void merge(const Aggregate& other)
+    {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    double mean() const { return count == 0 ? std::numeric_limits<double>::quiet_NaN() : sum / count; }
+};
+
+/*
+Summarise values[begin, end). Four independent lanes with selects instead of branches,
+so the compiler can keep them in vector registers.
+*/
+Aggregate aggregate_range(const double* values, std::size_t begin, std::size_t end)
+{
+    const int lanes = 4;
+    double sum[lanes] = {0, 0, 0, 0};
+    double low[lanes], high[lanes];
+    std::size_t count[lanes] = {0, 0, 0, 0};
+    for (int l = 0; l < lanes; ++l) {
+        low[l] = std::numeric_limits<double>::infinity();
+        high[l] = -std::numeric_limits<double>::infinity();
+    }
+
+    std::size_t i = begin;
+    for (; i + lanes <= end; i += lanes) {
+        for (int l = 0; l < lanes; ++l) {
+            double v = values[i + l];
+            bool valid = v == v;    // false for NaN
+            sum[l] += valid ? v : 0.0;
+            count[l] += valid;
+            low[l] = valid && v < low[l] ? v : low[l];
+            high[l] = valid && v > high[l] ? v : high[l];
+        }
+    }
+
+    Aggregate result;
+    for (int l = 0; l < lanes; ++l) {
+        result.merge(Aggregate{count[l], sum[l], low[l], high[l]});
+    }
+    for (; i < end; ++i) result.add(values[i]);
+    return result;
+}
+
+// The same for an integer column; integers have no NaN, so every value is counted.
+Aggregate aggregate_range(const std::int64_t* values, std::size_t begin, std::size_t end)
+{
+    const int lanes = 4;
+    double sum[lanes] = {0, 0, 0, 0};
+    double low[lanes], high[lanes];
+    for (int l = 0; l < lanes; ++l) {
+        low[l] = std::numeric_limits<double>::infinity();
+        high[l] = -std::numeric_limits<double>::infinity();
+    }
+
+    std::size_t i = begin;
+    for (; i + lanes <= end; i += lanes) {
+        for (int l = 0; l < lanes; ++l) {
+            double v = static_cast<double>(values[i + l]);
+            sum[l] += v;
+            low[l] = v < low[l] ? v : low[l];
+            high[l] = v > high[l] ? v : high[l];
+        }
+    }
+
+    Aggregate result;
+    for (int l = 0; l < lanes; ++l) {
+        result.merge(Aggregate{0, sum[l], low[l], high[l]});
+    }
+    result.count = i - begin;
+    for (; i < end; ++i) result.add(static_cast<double>(values[i]));
+    return result;
+}
+
+Aggregate aggregate_column(const ColumnTable& table, std::size_t column, unsigned threads = 1,
+                           const RowSelection* within = nullptr)
+{
+    ColumnType type = table.get_type(column);
+    if (type == ColumnType::text) {
+        throw std::invalid_argument("Column " + table.get_header(column) + " is not numeric");
+    }
+
+    bool is_real = type == ColumnType::real;
+    const double* reals = is_real ? table.reals(column).data() : nullptr;
+    const std::int64_t* integers = is_real ? nullptr : table.integers(column).data();
+    std::size_t n = within != nullptr ? within->size() : table.row_count();
+    std::size_t n_chunks = query_chunk_count(n, threads);
+    std::vector<Aggregate> parts(n_chunks);
+
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            std::size_t begin = n * k / n_chunks, end = n * (k + 1) / n_chunks;
+            if (within == nullptr) {
+                parts[k] = is_real ? aggregate_range(reals, begin, end) : aggregate_range(integers, begin, end);
+            } else if (is_real) {
+                for (std::size_t i = begin; i < end; ++i) parts[k].add(reals[(*within)[i]]);
+            } else {
+                for (std::size_t i = begin; i < end; ++i) parts[k].add(static_cast<double>(integers[(*within)[i]]));
+            }
+        }
+    });
+
+    Aggregate result;
+    for (auto it = parts.begin(); it != parts.end(); ++it) result.merge(*it);
+    return result;
+}
+
+// Aggregates per distinct key, kept in the order the keys first appear.
+template <typename Key>
+struct GroupMap
+{
+    std::unordered_map<Key, std::size_t> index;
+    std::vector<Key> keys;
+    std::vector<Aggregate> aggregates;
+
+    Aggregate& at(const Key& key)
+    {
+        auto inserted = index.emplace(key, keys.size());
+        if (inserted.second) {
+            keys.push_back(key);
+            aggregates.emplace_back();
+        }
+        return aggregates[inserted.first->second];
+    }
+};
+
+template <typename Key, typename KeyOf, typename ValueOf>
+GroupMap<Key> group_rows(std::size_t n, KeyOf key_of, ValueOf value_of, unsigned threads, const RowSelection* within)
+{
+    std::size_t n_chunks = query_chunk_count(n, threads);
+    std::vector<GroupMap<Key>> parts(n_chunks);
+
+    parallel_for(n_chunks, static_cast<unsigned>(n_chunks), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            std::size_t begin = n * k / n_chunks, end = n * (k + 1) / n_chunks;
+            for (std::size_t i = begin; i < end; ++i) {
+                std::size_t row = within != nullptr ? (*within)[i] : i;
+                parts[k].at(key_of(row)).add(value_of(row));
+            }
+        }
+    });
+
+    if (n_chunks == 1) return std::move(parts[0]);
+    GroupMap<Key> groups;
+    for (auto it = parts.begin(); it != parts.end(); ++it) {
+        for (std::size_t g = 0; g < it->keys.size(); ++g) {
+            groups.at(it->keys[g]).merge(it->aggregates[g]);
+        }
+    }
+    return groups;
+}
+
+// Bits of a double used as a hash key: every NaN is the same key, and so are 0 and -0.
+std::uint64_t real_key(double value)
+{
+    if (std::isnan(value)) value = std::numeric_limits<double>::quiet_NaN();
+    if (value == 0) value = 0;
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double real_from_key(std::uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+
+/*
+Group the rows by the value of key_column and aggregate value_column in every group.
+The result is a ColumnTable with the columns key, count, sum, mean, min and max, one row per
+group in order of first appearance.
+*/
+ColumnTable group_by(const ColumnTable& table, std::size_t key_column, std::size_t value_column,
+                     unsigned threads = 1, const RowSelection* within = nullptr)
+{
+    ColumnType value_type = table.get_type(value_column);
+    if (value_type == ColumnType::text) {
+        throw std::invalid_argument("Column " + table.get_header(value_column) + " is not numeric");
+    }
+    bool is_real = value_type == ColumnType::real;
+    const double* reals = is_real ? table.reals(value_column).data() : nullptr;
+    const std::int64_t* integers = is_real ? nullptr : table.integers(value_column).data();
+    auto value_of = [=](std::size_t row) { return is_real ? reals[row] : static_cast<double>(integers[row]); };
+    std::size_t n = within != nullptr ? within->size() : table.row_count();
+
+    ColumnTable result;
+    ColumnType key_type = table.get_type(key_column);
+    if (key_type == ColumnType::real) {
+        result.add_real_column(table.get_header(key_column), table.get_precision(key_column));
+    } else if (key_type == ColumnType::integer) {
+        result.add_integer_column(table.get_header(key_column));
+    } else {
+        result.add_text_column(table.get_header(key_column), table.get_alignment(key_column));
+    }
+    result.add_integer_column("count");
+    result.add_real_column("sum");
+    result.add_real_column("mean");
+    result.add_real_column("min");
+    result.add_real_column("max");
+
+    auto add_groups = [&](auto& groups, auto key_value) {
+        result.reserve(groups.keys.size());
+        for (std::size_t g = 0; g < groups.keys.size(); ++g) {
+            const Aggregate& a = groups.aggregates[g];
+            result.append_row(key_value(groups.keys[g]), a.count, a.sum, a.mean(), a.min, a.max);
+        }
+    };
+
+    if (key_type == ColumnType::real) {
+        const std::vector<double>& keys = table.reals(key_column);
+        GroupMap<std::uint64_t> groups = group_rows<std::uint64_t>(
+            n, [&](std::size_t row) { return real_key(keys[row]); }, value_of, threads, within);
+        add_groups(groups, real_from_key);
+    } else if (key_type == ColumnType::integer) {
+        const std::vector<std::int64_t>& keys = table.integers(key_column);
+        GroupMap<std::int64_t> groups = group_rows<std::int64_t>(
+            n, [&](std::size_t row) { return keys[row]; }, value_of, threads, within);
+        add_groups(groups, [](std::int64_t key) { return key; });
+    } else {
+        const std::vector<std::string>& keys = table.texts(key_column);
+        GroupMap<std::string_view> groups = group_rows<std::string_view>(
+            n, [&](std::size_t row) { return std::string_view(keys[row]); }, value_of, threads, within);
+        add_groups(groups, [](std::string_view key) { return key; });
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+This file defines the TableStream class, a streaming version of Table.
+Rows are written as soon as they arrive, so memory stays proportional to the
+number of columns instead of the number of cells.
+*/
+
+#ifndef TABLE_STREAM_HPP
+#define TABLE_STREAM_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include "DisplayWidth.hpp"
+
+enum class Alignment { left, right };
+
+/*
+Class name: TableStream
+--------------------
+Description: Prints a table in the same bordered format as Table::display_table(),
+one row at a time. Column widths have to be known before the header is written. They come from
+1. the headers alone (default),
+2. a schema: a vector of column widths passed to the constructor,
+3. a sample: rows passed to measure() before the first row is written,
+or any combination of them. A cell wider than its column is printed in full and breaks the
+alignment of that row only, like std::setw does in Table.
+Output is collected in a buffer and handed to the stream in large blocks; finish() writes
+what is left and is called by the destructor.
+----------------------------------------
+Attributes:
+- os: (std::ostream&) destination stream.
+- headers: (vector of strings) table headers.
+- widths: (vector of size_t) width of each column, excluding the two padding spaces.
+- alignment: (Alignment) alignment of the text inside the cells.
+- buffer: (string) output that has not been written to the stream yet.
+----------------------------------------
+Methods:
+- TableStream(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in)
+    Widths start at the header lengths.
+- TableStream(std::ostream& os_in, std::vector<std::string> headers_in,
+              std::vector<std::size_t> widths_in, Alignment alignment_in)
+    Widths given by a schema (never narrower than the headers).
+- measure(const Row& row), measure(It begin, It end)
+    Widen the columns to fit sample rows. Only allowed before write_header().
+- write_header()
+    Write the top border, the header row and the border below it.
+- write_row(const Row& row)
+    Write one row and the border below it. Writes the header first if needed.
+    Throws std::invalid_argument if the row does not have one cell per column.
+- render(It begin, It end)
+    Write every row of a range.
+- render(const std::function<bool(std::vector<std::string>&)>& next_row)
+    Pull rows from a callback until it returns false. The row vector is reused between calls.
+- finish()
+    Write the remaining buffered output.
+Row can be any container of std::string or std::string_view.
+*/
+class TableStream
+{
+private:
+    std::ostream& os;
+    std::vector<std::string> headers;
+    std::vector<std::size_t> widths;
+    Alignment alignment;
+    std::string buffer;
+    std::string div_line;
+    bool header_written = false;
+
+    static const std::size_t flush_threshold = 1 << 16;
+
+    template <typename Cell> void append_cell(const Cell& cell, std::size_t width);
+    void append_div_line();
+    void write_if_full();
+
+public:
+    TableStream(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in = Alignment::right);
+    TableStream(std::ostream& os_in, std::vector<std::string> headers_in, std::vector<std::size_t> widths_in,
+                Alignment alignment_in = Alignment::right);
+    ~TableStream() { finish(); }
+
+    const std::vector<std::size_t>& get_widths() const { return widths; }
+
+    template <typename Row> void measure(const Row& row);
+    template <typename It> void measure(It begin, It end);
+
+    void write_header();
+    template <typename Row> void write_row(const Row& row);
+    template <typename It> void render(It begin, It end);
+    void render(const std::function<bool(std::vector<std::string>&)>& next_row);
+    void finish();
+};
+
+TableStream::TableStream(std::ostream& os_in, std::vector<std::string> headers_in, Alignment alignment_in) :
+    os(os_in), headers(std::move(headers_in)), alignment(alignment_in)
+{
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        widths.push_back(display_width(*it));
+    }
+}
+
+TableStream::TableStream(std::ostream& os_in, std::vector<std::string> headers_in,
+                         std::vector<std::size_t> widths_in, Alignment alignment_in) :
+    TableStream(os_in, std::move(headers_in), alignment_in)
+{
+    if (widths_in.size() != widths.size()) {
+        throw std::invalid_argument("The schema must give one width per column");
+    }
+    for (std::size_t i = 0; i < widths.size(); ++i) {
+        widths[i] = std::max(widths[i], widths_in[i]);
+    }
+}
+
+template <typename Row>
+void TableStream::measure(const Row& row)
+{
+    if (header_written) {
+        throw std::logic_error("Column widths cannot change after the header is written");
+    }
+    std::size_t i = 0;
+    for (auto it = row.begin(); it != row.end() && i < widths.size(); ++it, ++i) {
+        widths[i] = std::max(widths[i], display_width(*it));
+    }
+}
+
+template <typename It>
+void TableStream::measure(It begin, It end)
+{
+    for (It it = begin; it != end; ++it) {
+        measure(*it);
+    }
+}
+
+// Pad the cell to width + 2 characters: two spaces of margin, then the aligned text.
+template <typename Cell>
+void TableStream::append_cell(const Cell& cell, std::size_t width)
+{
+    std::size_t cell_width = display_width(cell);
+    std::size_t padding = width + 2 > cell_width ? width + 2 - cell_width : 0;
+    buffer += '|';
+    if (alignment == Alignment::right) buffer.append(padding, ' ');
+    buffer.append(cell.data(), cell.size());
+    if (alignment == Alignment::left) buffer.append(padding, ' ');
+}
+
+void TableStream::append_div_line()
+{
+    buffer += div_line;
+}
+
+void TableStream::write_if_full()
+{
+    if (buffer.size() >= flush_threshold) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+void TableStream::write_header()
+{
+    if (header_written) return;
+    header_written = true;
+
+    // The dividing line never changes once the widths are fixed, so it is built once.
+    for (auto it = widths.begin(); it != widths.end(); ++it) {
+        div_line += '+';
+        div_line.append(*it + 2, '-');
+    }
+    div_line += "+\n";
+
+    append_div_line();
+    for (std::size_t i = 0; i < headers.size(); ++i) {
+        append_cell(headers[i], widths[i]);
+    }
+    buffer += "|\n";
+    append_div_line();
+    write_if_full();
+}
+
+template <typename Row>
+void TableStream::write_row(const Row& row)
+{
+    if (!header_written) write_header();
+    if (static_cast<std::size_t>(row.size()) != widths.size()) {
+        throw std::invalid_argument("Row has " + std::to_string(row.size()) + " cells, expected " +
+                                    std::to_string(widths.size()));
+    }
+
+    std::size_t i = 0;
+    for (auto it = row.begin(); it != row.end(); ++it, ++i) {
+        append_cell(*it, widths[i]);
+    }
+    buffer += "|\n";
+    append_div_line();
+    write_if_full();
+}
+
+template <typename It>
+void TableStream::render(It begin, It end)
+{
+    write_header();
+    for (It it = begin; it != end; ++it) {
+        write_row(*it);
+    }
+    finish();
+}
+
+void TableStream::render(const std::function<bool(std::vector<std::string>&)>& next_row)
+{
+    write_header();
+    std::vector<std::string> row;
+    while (next_row(row)) {
+        write_row(row);
+    }
+    finish();
+}
+
+void TableStream::finish()
+{
+    if (!buffer.empty()) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+#endif
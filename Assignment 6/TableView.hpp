@@ -0,0 +1,257 @@
+/*
+This file defines the TableView class, which prints a window of rows of a Table
+(a page, the head, the tail or the rows around one row) without touching the rest of the table,
+so paging through millions of rows costs the same for every page.
+*/
+
+#ifndef TABLE_VIEW_HPP
+#define TABLE_VIEW_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "Table.hpp"
+#include "Parallel.hpp"
+#include "DisplayWidth.hpp"
+
+/*
+Where the column widths of a window come from:
+- window: the headers and the visible rows only. Columns are as narrow as they can be,
+  but may change from one page to the next.
+- blocks: the widest cell of every block of rows the window overlaps, read from a summary index.
+  Widths stay the same while paging inside a block and never cut a cell.
+- table: the widths of the whole table, the same as Table::display_table() prints.
+*/
+enum class WidthMode { window, blocks, table };
+
+/*
+Class name: TableView
+--------------------
+Description: Prints a range of rows of a Table in the same bordered format as display_table().
+Only the rows in the range are formatted; the column widths are computed according to the
+WidthMode, from the rows in the range (O(page size)), from a summary index of per-block
+widths (O(page size / block size) lookups) or from the widths the Table already keeps (O(1)).
+The view keeps a reference to the table, which must outlive it. Rows appended to the table
+after the index was built are measured directly until update_index() is called.
+----------------------------------------
+Attributes:
+- table: (const Table&) the table shown.
+- page_size: number of rows on a page.
+- mode: (WidthMode) where the widths come from.
+- block_rows: number of rows summarised by one entry of the index.
+- block_widths: (vector of unsigned) widest cell of each column in each block, block after block.
+- indexed_rows: number of rows covered by the index.
+----------------------------------------
+Methods:
+- TableView(const Table& table_in, std::size_t page_size_in, WidthMode mode_in, std::size_t block_rows_in, unsigned threads)
+    Builds the summary index when the mode is blocks. Throws std::invalid_argument for a page
+    size or block size of 0.
+- set_mode(WidthMode mode_in, unsigned threads), set_page_size(std::size_t n)
+    Change the view. Switching to blocks builds the index if needed.
+- update_index(unsigned threads)
+    Build the summary index, or extend it to rows appended since it was built.
+    With threads > 1 (0 = every hardware thread) blocks are measured on separate threads.
+- page_count()
+    Number of pages, at least 1.
+- window_widths(std::size_t begin, std::size_t end)
+    Column widths used to print rows [begin, end).
+- display_rows(std::size_t begin, std::size_t end, std::ostream& os)
+    Print rows [begin, end), end is clamped to the number of rows.
+- display_page(std::size_t page, std::ostream& os)
+    Print page number page, counted from 0. Throws std::out_of_range for a page that does not exist.
+- display_head(std::size_t n, std::ostream& os), display_tail(std::size_t n, std::ostream& os)
+    Print the first or the last n rows.
+- display_around(std::size_t row, std::ostream& os)
+    Print a page of rows centred on row. Throws std::out_of_range for a row that does not exist.
+*/
+class TableView
+{
+private:
+    const Table& table;
+    std::size_t page_size;
+    WidthMode mode;
+    std::size_t block_rows;
+    std::vector<unsigned> block_widths;
+    std::size_t indexed_rows = 0;
+
+    static std::string make_div_line(const std::vector<unsigned>& widths);
+
+public:
+    TableView(const Table& table_in, std::size_t page_size_in = 50, WidthMode mode_in = WidthMode::window,
+              std::size_t block_rows_in = 1024, unsigned threads = 1);
+
+    void set_mode(WidthMode mode_in, unsigned threads = 1);
+    void set_page_size(std::size_t n);
+    void update_index(unsigned threads = 1);
+
+    std::size_t get_page_size() const { return page_size; }
+    WidthMode get_mode() const { return mode; }
+    std::size_t page_count() const;
+    std::vector<unsigned> window_widths(std::size_t begin, std::size_t end) const;
+
+    void display_rows(std::size_t begin, std::size_t end, std::ostream& os = std::cout) const;
+    void display_page(std::size_t page, std::ostream& os = std::cout) const;
+    void display_head(std::size_t n, std::ostream& os = std::cout) const;
+    void display_tail(std::size_t n, std::ostream& os = std::cout) const;
+    void display_around(std::size_t row, std::ostream& os = std::cout) const;
+};
+
+TableView::TableView(const Table& table_in, std::size_t page_size_in, WidthMode mode_in, std::size_t block_rows_in,
+                     unsigned threads) :
+    table(table_in), page_size(page_size_in), mode(mode_in), block_rows(block_rows_in)
+{
+    if (page_size == 0) throw std::invalid_argument("The page size must be at least 1");
+    if (block_rows == 0) throw std::invalid_argument("The block size must be at least 1");
+    if (mode == WidthMode::blocks) update_index(threads);
+}
+
+void TableView::set_mode(WidthMode mode_in, unsigned threads)
+{
+    mode = mode_in;
+    if (mode == WidthMode::blocks) update_index(threads);
+}
+
+void TableView::set_page_size(std::size_t n)
+{
+    if (n == 0) throw std::invalid_argument("The page size must be at least 1");
+    page_size = n;
+}
+
+/*
+Measure the blocks that are not in the index yet. The last block may have been partial,
+so it is measured again from its first row. Every block is written by one thread only.
+*/
+void TableView::update_index(unsigned threads)
+{
+    const std::vector<std::vector<std::string>>& rows = table.get_rows();
+    const std::size_t n_columns = table.get_headers().size();
+    const std::size_t first_block = indexed_rows / block_rows;
+    const std::size_t n_blocks = (rows.size() + block_rows - 1) / block_rows;
+
+    block_widths.resize(n_blocks * n_columns);
+    parallel_for(n_blocks - first_block, threads, [&](std::size_t first, std::size_t last) {
+        for (std::size_t b = first_block + first; b < first_block + last; ++b) {
+            unsigned* widths = block_widths.data() + b * n_columns;
+            std::fill(widths, widths + n_columns, 0u);
+            std::size_t end = std::min(rows.size(), (b + 1) * block_rows);
+            for (std::size_t r = b * block_rows; r < end; ++r) {
+                for (std::size_t i = 0; i < n_columns; ++i) {
+                    widths[i] = std::max(widths[i], static_cast<unsigned>(display_width(rows[r][i])));
+                }
+            }
+        }
+    });
+    indexed_rows = rows.size();
+}
+
+std::size_t TableView::page_count() const
+{
+    return std::max<std::size_t>(1, (table.get_rows().size() + page_size - 1) / page_size);
+}
+
+std::vector<unsigned> TableView::window_widths(std::size_t begin, std::size_t end) const
+{
+    if (mode == WidthMode::table) return table.get_max_length_each_col();
+
+    const std::vector<std::vector<std::string>>& rows = table.get_rows();
+    const std::vector<std::string>& headers = table.get_headers();
+    end = std::min(end, rows.size());
+
+    std::vector<unsigned> widths;
+    widths.reserve(headers.size());
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+        widths.push_back(static_cast<unsigned>(display_width(*it)));
+    }
+
+    // Rows the index does not cover are measured one by one.
+    std::size_t measure_from = begin;
+    if (mode == WidthMode::blocks && begin < end) {
+        std::size_t indexed_end = std::min(end, indexed_rows);
+        if (begin < indexed_end) {
+            for (std::size_t b = begin / block_rows; b <= (indexed_end - 1) / block_rows; ++b) {
+                const unsigned* block = block_widths.data() + b * headers.size();
+                for (std::size_t i = 0; i < widths.size(); ++i) {
+                    widths[i] = std::max(widths[i], block[i]);
+                }
+            }
+            measure_from = indexed_end;
+        }
+    }
+    for (std::size_t r = measure_from; r < end; ++r) {
+        update_max_length(widths, rows[r]);
+    }
+    return widths;
+}
+
+std::string TableView::make_div_line(const std::vector<unsigned>& widths)
+{
+    std::string line;
+    for (auto it = widths.begin(); it != widths.end(); ++it) {
+        line += '+';
+        line.append(*it + 2, '-');
+    }
+    line += "+\n";
+    return line;
+}
+
+void TableView::display_rows(std::size_t begin, std::size_t end, std::ostream& os) const
+{
+    const std::vector<std::vector<std::string>>& rows = table.get_rows();
+    end = std::min(end, rows.size());
+    begin = std::min(begin, end);
+
+    const std::vector<unsigned> widths = window_widths(begin, end);
+    const std::string div_line = make_div_line(widths);
+    std::string buffer;
+
+    // print headers
+    buffer += div_line;
+    append_table_line(buffer, table.get_headers(), widths);
+    buffer += div_line;
+
+    // print rows
+    for (std::size_t i = begin; i < end; ++i) {
+        append_table_line(buffer, rows[i], widths);
+        buffer += div_line;
+    }
+    os.write(buffer.data(), buffer.size());
+    os.flush();
+}
+
+void TableView::display_page(std::size_t page, std::ostream& os) const
+{
+    if (page >= page_count()) {
+        throw std::out_of_range("Page " + std::to_string(page) + " does not exist, the table has " +
+                                std::to_string(page_count()) + " pages");
+    }
+    display_rows(page * page_size, (page + 1) * page_size, os);
+}
+
+void TableView::display_head(std::size_t n, std::ostream& os) const
+{
+    display_rows(0, n, os);
+}
+
+void TableView::display_tail(std::size_t n, std::ostream& os) const
+{
+    std::size_t n_rows = table.get_rows().size();
+    display_rows(n_rows - std::min(n, n_rows), n_rows, os);
+}
+
+// A full page when the table is long enough, shifted near the first and the last row.
+void TableView::display_around(std::size_t row, std::ostream& os) const
+{
+    std::size_t n_rows = table.get_rows().size();
+    if (row >= n_rows) {
+        throw std::out_of_range("Row " + std::to_string(row) + " does not exist, the table has " +
+                                std::to_string(n_rows) + " rows");
+    }
+    std::size_t begin = row - std::min(row, page_size / 2);
+    begin = std::min(begin, n_rows - std::min(n_rows, page_size));
+    display_rows(begin, begin + page_size, os);
+}
+
+#endif
@@ -0,0 +1,535 @@
+/*
++-----------------------------------------------------+
+| Benchmarks for the Table classes                    |
++-----------------------------------------------------+
+Build:  g++ -std=c++20 -O3 -pthread benchmark.cpp -o benchmark
+Usage:  ./benchmark [name]
+Without a name every benchmark is run. The results are printed with Table.hpp.
+Heap allocations are counted by replacing the global operator new.
+*/
+#include "Table.hpp"
+#include "ColumnTable.hpp"
+#include "IncrementalTable.hpp"
+#include "TableExport.hpp"
+#include "CsvReader.hpp"
+#include "TableQuery.hpp"
+#include "SchemaTable.hpp"
+#include "TableView.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Number of calls to operator new since the start of the program.
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc{};
+}
+
+// Out of line, so the compiler does not pair the inlined free() with the builtin operator new.
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Time a callable and return the elapsed wall time in milliseconds.
+template <typename F>
+double time_ms(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Run a callable and return the number of heap allocations it made.
+template <typename F>
+std::size_t count_allocations(F&& f)
+{
+    std::size_t before = allocation_count;
+    f();
+    return allocation_count - before;
+}
+
+// Cells long enough to defeat the small string optimisation, so every copy allocates.
+std::vector<std::vector<std::string>> make_rows(std::size_t n, std::size_t columns)
+{
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::vector<std::string> row;
+        row.reserve(columns);
+        for (std::size_t j = 0; j < columns; ++j) {
+            row.push_back("cell value " + std::to_string(i) + "/" + std::to_string(j) + " of the table");
+        }
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
+
+void benchmark_construction()
+{
+    const std::size_t n = 100000;
+    const std::size_t columns = 6;
+    std::vector<std::string> headers{"A", "B", "C", "D", "E", "F"};
+    std::vector<std::vector<std::string>> source = make_rows(n, columns);
+
+    std::vector<std::string> result_headers{"Construction", "Allocations", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+    std::size_t allocations = 0;
+    double t = 0;
+
+    // What the constructor used to do: copy the arguments into the members, build the
+    // columns and copy them once more into get_max_length().
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            std::vector<std::string> h = headers;
+            std::vector<std::vector<std::string>> r = source;
+            Table table{h, r};
+            std::vector<std::vector<std::string>> stored_columns = table.get_columns();
+            std::vector<unsigned> widths = get_max_length(std::vector<std::vector<std::string>>(stored_columns));
+        });
+    });
+    results.push_back({"previous constructor (copies)", to_string_format(allocations), to_string_format(t)});
+
+    allocations = count_allocations([&] {
+        t = time_ms([&] { Table table{headers, source}; });
+    });
+    results.push_back({"copy arguments in", to_string_format(allocations), to_string_format(t)});
+
+    std::vector<std::vector<std::string>> moved = source;
+    allocations = count_allocations([&] {
+        t = time_ms([&] { Table table{headers, std::move(moved)}; });
+    });
+    results.push_back({"move rows in", to_string_format(allocations), to_string_format(t)});
+
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            Table table{headers};
+            table.reserve_rows(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                const std::vector<std::string>& row = source[i];
+                table.emplace_row(row[0], row[1], row[2], row[3], row[4], row[5]);
+            }
+        });
+    });
+    results.push_back({"reserve_rows + emplace_row", to_string_format(allocations), to_string_format(t)});
+
+    std::cout << "\nBuilding a table of " << n << " rows x " << columns << " columns:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_column_table()
+{
+    const std::size_t n = 200000;
+    std::mt19937_64 generator{1};
+    std::uniform_real_distribution<double> distribution{-1000.0, 1000.0};
+    std::vector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+    }
+
+    std::vector<std::string> result_headers{"Table", "Allocations", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+    std::ostringstream table_output, column_output;
+    std::size_t allocations = 0;
+    double t = 0;
+
+    // Every cell converted with to_string_format() up front.
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            Table table{{"Index", "x", "y"}};
+            table.reserve_rows(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                table.emplace_row(to_string_format(i), to_string_format(x[i]), to_string_format(y[i]));
+            }
+            table.display_table(table_output);
+        });
+    });
+    results.push_back({"Table + to_string_format", to_string_format(allocations), to_string_format(t)});
+
+    // Reserve the output so only the table itself is counted.
+    std::string reserved(table_output.str().size(), ' ');
+    column_output.str(reserved);
+    column_output.seekp(0);
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            ColumnTable table;
+            table.add_integer_column("Index");
+            table.add_real_column("x");
+            table.add_real_column("y");
+            table.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                table.append_row(i, x[i], y[i]);
+            }
+            table.display_table(column_output);
+        });
+    });
+    results.push_back({"ColumnTable", to_string_format(allocations), to_string_format(t)});
+
+    std::ostringstream schema_output;
+    schema_output.str(reserved);
+    schema_output.seekp(0);
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            SchemaTable<std::size_t, double, double> table{"Index", "x", "y"};
+            table.reserve_rows(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                table.append_row(i, x[i], y[i]);
+            }
+            table.display_table(schema_output);
+        });
+    });
+    results.push_back({"SchemaTable", to_string_format(allocations), to_string_format(t)});
+
+    bool identical = table_output.str() == column_output.str() && table_output.str() == schema_output.str();
+    std::cout << "\nPrinting " << n << " rows of numbers (output "
+              << (identical ? "identical" : "DIFFERENT") << "):" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_incremental()
+{
+    const std::size_t n = 2000;
+    std::vector<std::string> headers{"Step", "Loss", "Status"};
+    std::vector<std::string> result_headers{"Progress table", "Bytes written", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+    std::ostringstream rebuilt_output, incremental_output;
+
+    // A new Table with every row so far, printed after each step.
+    double t_rebuild = time_ms([&] {
+        std::vector<std::vector<std::string>> rows;
+        for (std::size_t i = 0; i < n; ++i) {
+            rows.push_back({to_string_format(i), to_string_format(1.0 / (i + 1)), "running"});
+            Table table{headers, rows};
+            table.display_table(rebuilt_output);
+        }
+    });
+    results.push_back({"rebuild Table each step", to_string_format(rebuilt_output.str().size()),
+                       to_string_format(t_rebuild)});
+
+    double t_incremental = time_ms([&] {
+        IncrementalTable table{incremental_output, headers};
+        for (std::size_t i = 0; i < n; ++i) {
+            table.append_row({to_string_format(i), to_string_format(1.0 / (i + 1)), "running"});
+            if (i > 0) table.update_cell(i - 1, 2, "done");
+            table.refresh();
+        }
+    });
+    results.push_back({"IncrementalTable::refresh", to_string_format(incremental_output.str().size()),
+                       to_string_format(t_incremental)});
+
+    std::cout << "\nPrinting a progress table of " << n << " steps:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_export()
+{
+    const std::size_t n = 1000000;
+    ColumnTable table;
+    table.add_integer_column("Index");
+    table.add_real_column("Value");
+    table.add_text_column("Label");
+    table.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        table.append_row(i, 1.0 / (i + 1), i % 2 == 0 ? "even" : "odd, \"quoted\"");
+    }
+
+    std::vector<std::string> result_headers{"Format", "MB", "Time (ms)", "MB/s"};
+    std::vector<std::vector<std::string>> results;
+
+    auto run = [&](const std::string& format, TableWriter& writer, std::ostringstream& output) {
+        double t = time_ms([&] { writer.write_table(table); });
+        double megabytes = output.str().size() / 1e6;
+        results.push_back({format, to_string_format(megabytes), to_string_format(t),
+                           to_string_format(megabytes / (t / 1000))});
+    };
+
+    std::ostringstream box_output, csv_output, tsv_output, markdown_output, json_output;
+    double t_box = time_ms([&] { table.display_table(box_output); });
+    results.push_back({"box (display_table)", to_string_format(box_output.str().size() / 1e6), to_string_format(t_box),
+                       to_string_format(box_output.str().size() / 1e6 / (t_box / 1000))});
+
+    CsvWriter csv{csv_output};
+    run("CSV", csv, csv_output);
+    TsvWriter tsv{tsv_output};
+    run("TSV", tsv, tsv_output);
+    MarkdownWriter markdown{markdown_output};
+    run("Markdown", markdown, markdown_output);
+    JsonLinesWriter json{json_output};
+    run("JSON Lines", json, json_output);
+
+    std::cout << "\nExporting " << n << " rows:" << std::endl;
+    Table results_table{result_headers, results};
+    results_table.display_table();
+}
+
+void benchmark_csv()
+{
+    const std::size_t n = 1000000;
+    const std::string filename = "benchmark.csv";
+    {
+        ColumnTable table;
+        table.add_integer_column("Index");
+        table.add_real_column("Value");
+        table.add_text_column("Label");
+        table.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            table.append_row(i, 1.0 / (i + 1), i % 10 == 0 ? "quoted, \"label\"" : "label");
+        }
+        std::ofstream file{filename, std::ios::binary};
+        CsvWriter writer{file, ',', "\n"};
+        writer.write_table(table);
+    }
+
+    std::vector<std::string> result_headers{"Reader", "Rows", "Allocations", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+    std::size_t allocations = 0, rows = 0;
+    double t = 0;
+
+    // The usual hand written loop: getline, then split every line into strings.
+    allocations = count_allocations([&] {
+        t = time_ms([&] {
+            std::ifstream file{filename};
+            std::vector<std::vector<std::string>> table_rows;
+            std::string line;
+            std::getline(file, line);
+            while (std::getline(file, line)) {
+                std::vector<std::string> row;
+                std::string cell;
+                bool quoted = false;
+                for (std::size_t i = 0; i < line.size(); ++i) {
+                    char c = line[i];
+                    if (c == '"') {
+                        if (quoted && i + 1 < line.size() && line[i + 1] == '"') { cell += '"'; ++i; }
+                        else quoted = !quoted;
+                    } else if (c == ',' && !quoted) {
+                        row.push_back(cell);
+                        cell.clear();
+                    } else {
+                        cell += c;
+                    }
+                }
+                row.push_back(cell);
+                table_rows.push_back(row);
+            }
+            rows = table_rows.size();
+        });
+    });
+    results.push_back({"getline + split", to_string_format(rows), to_string_format(allocations), to_string_format(t)});
+
+    unsigned thread_counts[] = {1, 0};
+    for (int k = 0; k < 2; ++k) {
+        allocations = count_allocations([&] {
+            t = time_ms([&] {
+                CsvReader reader{filename, ',', true, thread_counts[k]};
+                rows = reader.row_count();
+            });
+        });
+        std::string name = thread_counts[k] == 1 ? "CsvReader, 1 thread" :
+                           "CsvReader, all threads (" + to_string_format(default_thread_count()) + ")";
+        results.push_back({name, to_string_format(rows), to_string_format(allocations), to_string_format(t)});
+    }
+    std::remove(filename.c_str());
+
+    std::cout << "\nReading a CSV file of " << n << " rows:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_query()
+{
+    const std::size_t n = 1000000;
+    std::mt19937_64 generator{3};
+    std::uniform_real_distribution<double> distribution{0.0, 100.0};
+    ColumnTable table;
+    table.add_integer_column("Group");
+    table.add_real_column("Value");
+    table.reserve(n);
+    std::vector<std::vector<std::string>> string_rows;
+    string_rows.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::int64_t group = static_cast<std::int64_t>(generator() % 1000);
+        double value = distribution(generator);
+        table.append_row(group, value);
+        string_rows.push_back({to_string_format(group), to_string_format(value)});
+    }
+
+    std::vector<std::string> result_headers{"Query", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+
+    // Sorting the rows themselves, parsing the keys in the comparison, as caller loops did.
+    double t = time_ms([&] {
+        std::stable_sort(string_rows.begin(), string_rows.end(),
+                         [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+                             return std::stoll(a[0]) != std::stoll(b[0]) ? std::stoll(a[0]) < std::stoll(b[0])
+                                                                        : std::stod(a[1]) > std::stod(b[1]);
+                         });
+    });
+    results.push_back({"sort string rows", to_string_format(t)});
+
+    RowSelection sorted;
+    t = time_ms([&] { sorted = sort_rows(table, {{0}, {1, SortOrder::descending}}); });
+    results.push_back({"sort_rows (2 keys)", to_string_format(t)});
+
+    RowSelection selected;
+    t = time_ms([&] { selected = filter_rows(table, 1, [](double v) { return v < 50; }); });
+    results.push_back({"filter_rows", to_string_format(t)});
+
+    unsigned thread_counts[] = {1, 0};
+    for (int k = 0; k < 2; ++k) {
+        std::string threads = thread_counts[k] == 1 ? " (1 thread)" : " (all threads)";
+        Aggregate total;
+        t = time_ms([&] { total = aggregate_column(table, 1, thread_counts[k]); });
+        results.push_back({"aggregate_column" + threads, to_string_format(t)});
+
+        ColumnTable groups;
+        t = time_ms([&] { groups = group_by(table, 0, 1, thread_counts[k]); });
+        results.push_back({"group_by, " + to_string_format(groups.row_count()) + " groups" + threads,
+                           to_string_format(t)});
+    }
+
+    std::cout << "\nQueries over " << n << " rows:" << std::endl;
+    Table results_table{result_headers, results};
+    results_table.display_table();
+}
+
+void benchmark_parallel()
+{
+    const std::size_t n = 1000000;
+    std::mt19937_64 generator{4};
+    std::uniform_real_distribution<double> distribution{-1.0, 1.0};
+    std::vector<std::vector<double>> numbers(n, std::vector<double>(3));
+    ColumnTable column_table;
+    column_table.add_real_column("x");
+    column_table.add_real_column("y");
+    column_table.add_real_column("z");
+    column_table.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) numbers[i][j] = distribution(generator);
+        column_table.append_row(numbers[i][0], numbers[i][1], numbers[i][2]);
+    }
+
+    std::vector<std::string> result_headers{"Step", "Threads", "Time (ms)", "Output"};
+    std::vector<std::vector<std::string>> results;
+    std::string reference_table, reference_columns;
+
+    unsigned thread_counts[] = {1, 0};
+    for (int k = 0; k < 2; ++k) {
+        unsigned threads = thread_counts[k];
+        std::string thread_name = threads == 1 ? "1" : "all (" + to_string_format(default_thread_count()) + ")";
+
+        Table table;
+        double t = time_ms([&] { table = Table{{"x", "y", "z"}, numbers, threads}; });
+        results.push_back({"Table: format + measure", thread_name, to_string_format(t), ""});
+
+        std::ostringstream table_output;
+        t = time_ms([&] { table.display_table(table_output, threads); });
+        if (threads == 1) reference_table = table_output.str();
+        results.push_back({"Table: render", thread_name, to_string_format(t),
+                           table_output.str() == reference_table ? "identical" : "DIFFERENT"});
+
+        std::ostringstream column_output;
+        t = time_ms([&] { column_table.display_table(column_output, threads); });
+        if (threads == 1) reference_columns = column_output.str();
+        results.push_back({"ColumnTable: measure + render", thread_name, to_string_format(t),
+                           column_output.str() == reference_columns ? "identical" : "DIFFERENT"});
+    }
+
+    std::cout << "\nBuilding and printing " << n << " rows of 3 numbers:" << std::endl;
+    Table results_table{result_headers, results};
+    results_table.display_table();
+}
+
+void benchmark_display_width()
+{
+    const std::size_t n = 1000000;
+    std::vector<std::string> ascii_cells, utf8_cells;
+    ascii_cells.reserve(n);
+    utf8_cells.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        ascii_cells.push_back("NGC " + std::to_string(i) + " spiral");
+        utf8_cells.push_back("Ångström " + std::to_string(i) + " 星系");
+    }
+
+    std::vector<std::string> result_headers{"Cells", "Measure", "Time (ms)", "Total width"};
+    std::vector<std::vector<std::string>> results;
+    auto run = [&](const std::string& cells_name, const std::vector<std::string>& cells, bool utf8_aware) {
+        std::size_t total = 0;
+        double t = time_ms([&] {
+            for (auto it = cells.begin(); it != cells.end(); ++it) {
+                total += utf8_aware ? display_width(*it) : it->length();
+            }
+        });
+        results.push_back({cells_name, utf8_aware ? "display_width()" : "length()", to_string_format(t),
+                           to_string_format(total)});
+    };
+    run("ASCII", ascii_cells, false);
+    run("ASCII", ascii_cells, true);
+    run("UTF-8", utf8_cells, false);
+    run("UTF-8", utf8_cells, true);
+
+    std::cout << "\nMeasuring " << n << " cells:" << std::endl;
+    Table table{result_headers, results};
+    table.display_table();
+}
+
+void benchmark_view()
+{
+    const std::size_t n = 1000000, columns = 6, page_size = 50;
+    Table table{{"A", "B", "C", "D", "E", "F"}, make_rows(n, columns)};
+
+    std::vector<std::string> result_headers{"Rendering", "Time (ms)"};
+    std::vector<std::vector<std::string>> results;
+    std::ostringstream output;
+    double t = time_ms([&] { table.display_table(output); });
+    results.push_back({"display_table(), whole table", to_string_format(t)});
+
+    const WidthMode modes[] = {WidthMode::window, WidthMode::blocks, WidthMode::table};
+    const char* names[] = {"window", "blocks", "table"};
+    for (std::size_t m = 0; m < 3; ++m) {
+        TableView view{table, page_size};
+        t = time_ms([&] { view.set_mode(modes[m]); });
+        if (modes[m] == WidthMode::blocks) results.push_back({"blocks index build", to_string_format(t)});
+
+        // 100 pages spread over the table.
+        t = time_ms([&] {
+            for (std::size_t k = 0; k < 100; ++k) {
+                output.str("");
+                view.display_page(k * (view.page_count() / 100), output);
+            }
+        });
+        results.push_back({std::string("TableView page, widths from ") + names[m], to_string_format(t / 100)});
+    }
+
+    std::cout << "\nPaging through " << n << " rows x " << columns << " columns, " << page_size
+              << " rows per page:" << std::endl;
+    Table result_table{result_headers, results};
+    result_table.display_table();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = argc > 1 ? argv[1] : "all";
+
+    if (name == "all" || name == "construction") benchmark_construction();
+    if (name == "all" || name == "columns") benchmark_column_table();
+    if (name == "all" || name == "incremental") benchmark_incremental();
+    if (name == "all" || name == "export") benchmark_export();
+    if (name == "all" || name == "csv") benchmark_csv();
+    if (name == "all" || name == "query") benchmark_query();
+    if (name == "all" || name == "parallel") benchmark_parallel();
+    if (name == "all" || name == "width") benchmark_display_width();
+    if (name == "all" || name == "view") benchmark_view();
+
+    return 0;
+}